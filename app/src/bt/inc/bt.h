@@ -4,11 +4,13 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define BT_PAYLOAD_LEN (7U)
+#define BT_PAYLOAD_LEN (20U)
 
 typedef void (*bt_connected_cb_t)(void);
+typedef void (*bt_disconnected_cb_t)(void);
 
-int bt_start(bt_connected_cb_t conn_cb);
+int bt_start(bt_connected_cb_t conn_cb, bt_disconnected_cb_t disconn_cb);
 int bt_send_notification(uint8_t *data, size_t len);
+int bt_broadcast_update(const uint8_t *data, size_t len);
 
 #endif /* _BT_H_ */
\ No newline at end of file
@@ -5,8 +5,13 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/settings/settings.h>
 #include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
 
 #include "bt.h"
+#include "prof.h"
+#include "loop_health.h"
+#include "summary.h"
+#include "timebase.h"
 
 #define BT_UUID_CUSTOM_SERVICE_VAL \
 	BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x1234, 0x56789abcdef0)
@@ -21,6 +26,7 @@ static uint8_t vnd_value[BT_PAYLOAD_LEN] = {0};
 
 static struct bt_conn *p_conn_handle = NULL;
 static bt_connected_cb_t connected_cb = NULL;
+static bt_disconnected_cb_t disconnected_cb = NULL;
 
 static ssize_t read_vnd(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 			void *buf, uint16_t len, uint16_t offset)
@@ -56,11 +62,183 @@ BT_GATT_SERVICE_DEFINE(vnd_svc,
 	BT_GATT_CCC(NULL, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
 );
 
+static const struct bt_uuid_128 diag_uuid = BT_UUID_INIT_128(
+	BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x1234, 0x56789abcdef2));
+
+static const struct bt_uuid_128 diag_chr_uuid = BT_UUID_INIT_128(
+	BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x1234, 0x56789abcdef3));
+
+/* PPG and EDA sampling loops */
+#define DIAG_NUM_LOOPS 2
+
+#if defined(CONFIG_APP_PROFILING)
+#define DIAG_PROF_LEN (PROF_STAGE_NUM * 3 * sizeof(uint32_t))
+#else
+#define DIAG_PROF_LEN 0
+#endif
+
+#define DIAG_VALUE_LEN (1 + DIAG_NUM_LOOPS * LOOP_HEALTH_ENTRY_LEN + DIAG_PROF_LEN)
+
+static ssize_t read_diag(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			 void *buf, uint16_t len, uint16_t offset)
+{
+	uint8_t value[DIAG_VALUE_LEN];
+	size_t value_len;
+
+	/* Number of loops first, so the profiling part can be located */
+	value_len = loop_health_serialize(&value[1], DIAG_NUM_LOOPS * LOOP_HEALTH_ENTRY_LEN);
+	value[0] = value_len / LOOP_HEALTH_ENTRY_LEN;
+	value_len++;
+
+#if defined(CONFIG_APP_PROFILING)
+	value_len += prof_serialize(&value[value_len], sizeof(value) - value_len);
+#endif
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, value,
+				 value_len);
+}
+
+/*
+ * Sampling loop health, see loop_health_serialize(), followed by per-stage
+ * min/avg/max cycle counters when profiling is enabled, see prof_serialize()
+ */
+BT_GATT_SERVICE_DEFINE(diag_svc,
+	BT_GATT_PRIMARY_SERVICE(&diag_uuid),
+	BT_GATT_CHARACTERISTIC(&diag_chr_uuid.uuid,
+						   BT_GATT_CHRC_READ,
+						   BT_GATT_PERM_READ,
+						   read_diag, NULL, NULL),
+);
+
+static const struct bt_uuid_128 summary_uuid = BT_UUID_INIT_128(
+	BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x1234, 0x56789abcdef4));
+
+static const struct bt_uuid_128 summary_chr_uuid = BT_UUID_INIT_128(
+	BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x1234, 0x56789abcdef5));
+
+/* Longest attribute value ATT allows */
+#define SUMMARY_PAGE_LEN 512
+
+static uint8_t summary_page[SUMMARY_PAGE_LEN];
+static size_t summary_page_len;
+static uint32_t summary_first_minute;
+
+static ssize_t read_summary(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			    void *buf, uint16_t len, uint16_t offset)
+{
+	/* The rest of a long read comes from the page of its first request, so
+	 * a minute closing in between cannot shift the records */
+	if (0 == offset) {
+		summary_page_len = summary_serialize(timebase_now_us(), summary_first_minute,
+						     summary_page, sizeof(summary_page));
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, summary_page,
+				 summary_page_len);
+}
+
+static ssize_t write_summary(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     const void *buf, uint16_t len, uint16_t offset,
+			     uint8_t flags)
+{
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(uint32_t)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	summary_first_minute = sys_get_le32(buf);
+
+	return len;
+}
+
+/*
+ * Per-minute summaries and HR zone totals, see summary_serialize(). A read
+ * returns the records from the minute last written as a little endian
+ * uint32, 0 after connecting, as many as fit a page. Bulk fetching is
+ * reading and writing the minute after the last record until a page has no
+ * records.
+ */
+BT_GATT_SERVICE_DEFINE(summary_svc,
+	BT_GATT_PRIMARY_SERVICE(&summary_uuid),
+	BT_GATT_CHARACTERISTIC(&summary_chr_uuid.uuid,
+						   BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+						   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+						   read_summary, write_summary, NULL),
+);
+
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
 	BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_CUSTOM_SERVICE_VAL),
 };
 
+#if defined(CONFIG_APP_BT_BROADCAST)
+
+/* Bluetooth SIG company identifier reserved for testing */
+#define BCAST_COMPANY_ID 0xFFFF
+
+/* Company ID, sequence number, payload */
+#define BCAST_DATA_LEN (2 + 1 + BT_PAYLOAD_LEN)
+
+static struct bt_le_ext_adv *p_bcast_adv;
+static uint8_t bcast_data[BCAST_DATA_LEN];
+static uint8_t bcast_seq;
+
+static const struct bt_data bcast_ad[] = {
+	BT_DATA(BT_DATA_MANUFACTURER_DATA, bcast_data, BCAST_DATA_LEN),
+};
+
+static int bt_broadcast_start(void)
+{
+	int err;
+
+	sys_put_le16(BCAST_COMPANY_ID, bcast_data);
+
+	err = bt_le_ext_adv_create(BT_LE_EXT_ADV_NCONN, NULL, &p_bcast_adv);
+	if (err) {
+		printk("Broadcast set creation failed (err %d)\n", err);
+		return err;
+	}
+
+	err = bt_le_ext_adv_set_data(p_bcast_adv, bcast_ad, ARRAY_SIZE(bcast_ad),
+				     NULL, 0);
+	if (err) {
+		printk("Broadcast data failed (err %d)\n", err);
+		return err;
+	}
+
+	err = bt_le_ext_adv_start(p_bcast_adv, BT_LE_EXT_ADV_START_DEFAULT);
+	if (err) {
+		printk("Broadcast failed to start (err %d)\n", err);
+		return err;
+	}
+
+	printk("Broadcast successfully started\n");
+
+	return 0;
+}
+
+/*
+ * Replaces the broadcast payload. The sequence number rolls over at 256 and
+ * lets observers tell a new snapshot from a repeated advertising event.
+ */
+int bt_broadcast_update(const uint8_t *data, size_t len)
+{
+	if (!p_bcast_adv || !data || (len > BT_PAYLOAD_LEN)) {
+		return -EINVAL;
+	}
+
+	bcast_data[2] = ++bcast_seq;
+	memcpy(&bcast_data[3], data, len);
+
+	return bt_le_ext_adv_set_data(p_bcast_adv, bcast_ad, ARRAY_SIZE(bcast_ad),
+				      NULL, 0);
+}
+
+#endif /* CONFIG_APP_BT_BROADCAST */
+
 static void connected(struct bt_conn *conn, uint8_t err)
 {
 	if (err) {
@@ -68,6 +246,7 @@ static void connected(struct bt_conn *conn, uint8_t err)
 	} else {
 		printk("Connected\n");
 		p_conn_handle = conn;
+		summary_first_minute = 0;
         if (connected_cb)
         {
             connected_cb();
@@ -79,6 +258,9 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	printk("Disconnected (reason 0x%02x)\n", reason);
 	p_conn_handle = NULL;
+	if (disconnected_cb) {
+		disconnected_cb();
+	}
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
@@ -96,6 +278,14 @@ static void bt_ready(void)
 		settings_load();
 	}
 
+#if defined(CONFIG_APP_BT_BROADCAST)
+	err = bt_broadcast_start();
+	if (err && IS_ENABLED(CONFIG_APP_BT_BROADCAST_ONLY)) {
+		return;
+	}
+#endif
+
+#if !defined(CONFIG_APP_BT_BROADCAST_ONLY)
 	err = bt_le_adv_start(BT_LE_ADV_CONN_NAME, ad, ARRAY_SIZE(ad), NULL, 0);
 	if (err) {
 		printk("Advertising failed to start (err %d)\n", err);
@@ -103,13 +293,15 @@ static void bt_ready(void)
 	}
 
 	printk("Advertising successfully started\n");
+#endif
 }
 
-int bt_start(bt_connected_cb_t conn_cb)
+int bt_start(bt_connected_cb_t conn_cb, bt_disconnected_cb_t disconn_cb)
 {
 	int err;
 
     connected_cb = conn_cb;
+    disconnected_cb = disconn_cb;
 
 	err = bt_enable(NULL);
 	if (err) {
@@ -3,8 +3,18 @@
 
 #include <stdint.h>
 
+#include "eda_proc.h"
+
+typedef enum eda_cal_type
+{
+    EDA_CAL_NONE,
+    EDA_CAL_OFFSET, // Electrodes open
+    EDA_CAL_GAIN,   // Electrodes shorted
+} eda_cal_type_t;
+
 int eda_init(void);
 void eda_start_sampling(void);
-uint32_t eda_get_epc(void);
+void eda_stop_sampling(void);
+int eda_calibrate(eda_cal_type_t type);
 
 #endif /* _EDA_H_ */
\ No newline at end of file
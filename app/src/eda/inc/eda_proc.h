@@ -0,0 +1,44 @@
+#ifndef _EDA_PROC_H_
+#define _EDA_PROC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scr.h"
+
+#define EDA_SAMPLE_PERIOD_MS (1000 / CONFIG_APP_EDA_SAMPLE_RATE_HZ)
+
+// Period of the averaged samples the filter and the SCR detector run on
+#define EDA_DECIMATED_PERIOD_MS (EDA_SAMPLE_PERIOD_MS * CONFIG_APP_EDA_DECIMATION)
+
+#define EDA_ADC_RESOLUTION_BITS 12
+
+// Averaged ADC codes are kept with 4 fractional bits
+#define EDA_CODE_FRAC_BITS 4
+
+#define EDA_CAL_GAIN_FRAC_BITS 15
+
+// Offset seen on the ESP32-C3 before calibration existed, used until the
+// first calibration completes
+#define EDA_CAL_DEFAULT_OFFSET 1023
+
+// Reference voltage of the EDA divider, seen at the ADC with shorted electrodes
+#define EDA_U_REF_MV 500
+
+typedef struct eda_cal
+{
+    uint32_t gain;   // Correction of the ADC reference, EDA_CAL_GAIN_FRAC_BITS
+    uint16_t offset; // Raw code with the electrodes open
+    uint16_t reserved;
+} eda_cal_t;
+
+int eda_proc_init(void);
+int eda_proc_reset(void);
+void eda_proc_set_cal(const eda_cal_t *p_cal, int32_t full_scale_mv);
+bool eda_proc_put_sample(uint16_t raw, scr_event_t *p_event);
+void eda_proc_sync_time(int64_t now_us);
+
+uint32_t eda_get_epc(void);
+uint32_t eda_get_range_ns(void);
+
+#endif /* _EDA_PROC_H_ */
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef _SCR_H_
+#define _SCR_H_
+
+#include <stdint.h>
+
+typedef struct scr_event
+{
+    int64_t ts_us;          // Onset on the shared timebase, set by eda_proc
+    float amplitude_ns;
+    uint32_t rise_time_ms;
+} scr_event_t;
+
+int scr_init(void);
+int scr_reset(void);
+int scr_put_sample(float eda_ns, scr_event_t *p_event);
+uint32_t scr_get_tonic_ns(void);
+uint32_t scr_get_rate_per_min(void);
+
+#endif /* _SCR_H_ */
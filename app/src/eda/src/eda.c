@@ -3,29 +3,41 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/adc.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/shell/shell.h>
 
-#include <math.h>
-
-#include "ring_buffer.h"
-
-#define SAMPLE_PERIOD_MS 10 // 100 Hz
+#include "prof.h"
+#include "loop_health.h"
+#include "summary.h"
+#include "timebase.h"
 
 #define SMPL_THRD_STACK_SIZE (8192U)
 #define SMPL_THRD_PRIO 2
 
-#define OVERSAMPLING_BUF_SIZE 10 // 10 Hz after averaging
-#define EDA_BUF_SIZE 100
+// Raw samples averaged for an offset or gain calibration
+#define CAL_NUM_SAMPLES 64
+
+// Open electrodes read close to the default offset, anything further off
+// means skin contact or a fault and is not taken as the offset
+#define CAL_OFFSET_TOL 128
+
+// Open electrodes leave only the ADC noise, skin contact adds the slow EDA
+// changes and motion. Largest variance in codes^2 of an automatic offset.
+#define CAL_OPEN_MAX_VAR 16
 
-#define NUM_FILT_COEFS 13
+// The gain corrects the eFuse calibrated ADC reference by a few percent
+#define CAL_GAIN_MIN (3 << (EDA_CAL_GAIN_FRAC_BITS - 2))
+#define CAL_GAIN_MAX (5 << (EDA_CAL_GAIN_FRAC_BITS - 2))
 
 LOG_MODULE_REGISTER(eda, CONFIG_APP_LOG_LEVEL);
 
 static void eda_smpl_thrd_run(void *p1, void *p2, void *p3);
-static inline float fir_filter(int32_t new_sample,
-                            int32_t *filt_sample_buf, 
-                            const float *filt_coefs, 
-                            size_t num_coefs);
-static inline float mv_to_eda_ns(float mv);
+static void eda_cal_put_sample(uint16_t raw);
+static bool eda_cal_is_valid(const eda_cal_t *p_cal);
+static int eda_settings_set(const char *name, size_t len,
+                            settings_read_cb read_cb, void *cb_arg);
 
 static K_THREAD_DEFINE(eda_smpl_thrd,
                        8192,
@@ -34,6 +46,7 @@ static K_THREAD_DEFINE(eda_smpl_thrd,
                        SMPL_THRD_PRIO, 0, 0);
 
 static K_TIMER_DEFINE(sampling_tmr, NULL, NULL);
+static K_SEM_DEFINE(start_sem, 0, 1);
 
 static const struct adc_dt_spec adc_channel = ADC_DT_SPEC_GET(DT_PATH(zephyr_user));
 
@@ -43,30 +56,24 @@ static struct adc_sequence adc_seq = {
     .buffer_size = sizeof(adc_buf),
 };
 
-static int32_t oversampling_buf[OVERSAMPLING_BUF_SIZE];
-static size_t oversampling_buf_idx;
-
-static float eda_buf[EDA_BUF_SIZE];
-static ring_buffer_t eda_ring_buf;
-
-static const float filt_coefs[NUM_FILT_COEFS] = {
-    -0.002719748296486632f,
-    1.2038218586409178e-18f,
-    0.01580853697332853f,
-    0.05940870999155988f,
-    0.12706862970416977f,
-    0.19141010953237056f,
-    0.21804752419011558f,
-    0.19141010953237056f,
-    0.12706862970416982f,
-    0.05940870999155988f,
-    0.01580853697332855f,
-    1.2038218586409182e-18f,
-    -0.002719748296486632f, 
+static loop_health_t eda_loop_health;
+
+// ADC input at a code of 2^EDA_ADC_RESOLUTION_BITS
+static int32_t adc_full_scale_mv;
+
+static eda_cal_t eda_cal = {
+    .gain = 1 << EDA_CAL_GAIN_FRAC_BITS,
+    .offset = EDA_CAL_DEFAULT_OFFSET,
 };
+static bool eda_cal_loaded;
 
-static int32_t filt_sample_buf[NUM_FILT_COEFS];
-static size_t filt_sample_num;
+static atomic_t cal_request = ATOMIC_INIT(EDA_CAL_NONE);
+static bool cal_auto;
+static uint32_t cal_sum;
+static uint64_t cal_sum_sq;
+static uint32_t cal_cnt;
+
+SETTINGS_STATIC_HANDLER_DEFINE(eda, "eda", NULL, eda_settings_set, NULL, NULL);
 
 int eda_init(void)
 {
@@ -92,135 +99,320 @@ int eda_init(void)
 	    return err;
     }
 
-    memset(oversampling_buf, 0, OVERSAMPLING_BUF_SIZE * sizeof(int32_t));
-    oversampling_buf_idx = 0;
-    memset(filt_sample_buf, 0, NUM_FILT_COEFS * sizeof(int32_t));
-    filt_sample_num = 0;
+    // Calibration is cached in settings, only boots without one measure it
+    err = settings_subsys_init();
+    if (0 == err)
+    {
+        err = settings_load_subtree("eda");
+    }
+    if (err < 0)
+    {
+        LOG_WRN("Could not load EDA calibration (%d)", err);
+    }
+
+    // The electrodes may already be worn, so the first sampling only
+    // measures the offset and keeps it if they look open
+    if (!eda_cal_loaded)
+    {
+        LOG_INF("No EDA calibration stored, calibrating offset");
+        cal_auto = true;
+        eda_calibrate(EDA_CAL_OFFSET);
+    }
 
-    err = ring_buffer_init(&eda_ring_buf, eda_buf, EDA_BUF_SIZE);
+    adc_full_scale_mv = 1 << EDA_ADC_RESOLUTION_BITS;
+    err = adc_raw_to_millivolts_dt(&adc_channel, &adc_full_scale_mv);
     if (err < 0)
     {
-        LOG_ERR("Failed to init EDA ring buffer");
-        return err;
+	    LOG_ERR("Could not get ADC reference (%d)", err);
+	    return err;
     }
 
-    return err;
-}
+    eda_proc_set_cal(&eda_cal, adc_full_scale_mv);
 
-void eda_start_sampling(void)
-{
-    k_timer_start(&sampling_tmr, K_MSEC(SAMPLE_PERIOD_MS), K_MSEC(SAMPLE_PERIOD_MS));
+    err = eda_proc_init();
+
+    if (0 == err)
+    {
+        err = loop_health_init(&eda_loop_health, "eda", EDA_SAMPLE_PERIOD_MS * 1000U);
+    }
+
+    PROF_SET_BUDGET_US(PROF_STAGE_EDA_LOOP, EDA_SAMPLE_PERIOD_MS * 1000U);
+
+    return err;
 }
 
-uint32_t eda_get_epc(void)
+// Requests a calibration on the next CAL_NUM_SAMPLES raw samples. The EDA
+// pipeline pauses meanwhile. A plausible result is applied and stored in
+// settings, otherwise the previous calibration stays.
+int eda_calibrate(eda_cal_type_t type)
 {
-    float epc = 0.0f;
-    float eda_samples_buf[EDA_BUF_SIZE];
-    int num_items;
+    if ((type != EDA_CAL_OFFSET) && (type != EDA_CAL_GAIN))
+    {
+        return -EINVAL;
+    }
 
-    if (ring_buffer_get_num_items(&eda_ring_buf) > 1)
+    if (!atomic_cas(&cal_request, EDA_CAL_NONE, type))
     {
-        num_items = ring_buffer_copy_inorder(&eda_ring_buf, eda_samples_buf);
-        
-        for(int i = 1; i < num_items; i++)
-        {
-            if (eda_samples_buf[i] > eda_samples_buf[i-1])
-            {
-                epc += eda_samples_buf[i] - eda_samples_buf[i-1];
-            }
-        }
+        return -EBUSY;
     }
 
-    return (uint32_t) roundf(epc);
+    return 0;
+}
+
+// Sampling runs in the EDA thread, which resumes the ADC and starts from a
+// clean state
+void eda_start_sampling(void)
+{
+    k_sem_give(&start_sem);
+}
+
+// The EDA thread notices the stopped timer and suspends the ADC
+void eda_stop_sampling(void)
+{
+    k_timer_stop(&sampling_tmr);
 }
 
 static void eda_smpl_thrd_run(void *p1, void *p2, void *p3)
 {
     int err;
-    int32_t mv;
-    int32_t avg_mv;
-    float filtered_sample;
-    float eda_value_ns;
+    uint32_t expirations;
+    uint32_t num_scr;
+    int64_t now_us;
 
     for(;;)
     {
-        k_timer_status_sync(&sampling_tmr);
+        k_sem_take(&start_sem, K_FOREVER);
 
-        err = adc_read_dt(&adc_channel, &adc_seq);
+        err = pm_device_runtime_get(adc_channel.dev);
         if (err < 0)
         {
-            LOG_ERR("Error reading from ADC");
+            LOG_ERR("Could not resume ADC (%d)", err);
+            continue;
         }
-        else
+
+        eda_proc_reset();
+        loop_health_restart(&eda_loop_health);
+
+        k_timer_start(&sampling_tmr, K_MSEC(EDA_SAMPLE_PERIOD_MS), K_MSEC(EDA_SAMPLE_PERIOD_MS));
+
+        for(;;)
         {
-            // HACK! For some reason the ADC readings are offset by 1023, possible
-            // bug in the ESP32 ADC driver
-            if (adc_buf >= 1023)
+            expirations = k_timer_status_sync(&sampling_tmr);
+
+            // No expirations means the timer was stopped
+            if (0 == expirations)
             {
-                adc_buf = adc_buf - 1023;
+                break;
             }
-            else
+
+            PROF_START(PROF_STAGE_EDA_LOOP);
+
+            loop_health_wakeup(&eda_loop_health, expirations);
+
+            err = adc_read_dt(&adc_channel, &adc_seq);
+            if (err < 0)
             {
-                adc_buf = 0;
+                LOG_ERR("Error reading from ADC");
             }
-            
-            mv = adc_buf;
-            adc_raw_to_millivolts_dt(&adc_channel, &mv);
-
-            oversampling_buf[oversampling_buf_idx++] = mv;
-            if (oversampling_buf_idx >= OVERSAMPLING_BUF_SIZE)
+            else if (atomic_get(&cal_request) != EDA_CAL_NONE)
+            {
+                eda_cal_put_sample(adc_buf);
+            }
+            else
             {
-                oversampling_buf_idx = 0;
-                avg_mv = 0;
-                for (size_t i = 0; i < OVERSAMPLING_BUF_SIZE; i++)
+                // The ADC is read on demand, so missed periods cannot be
+                // recovered. Hold the current sample for each of them to keep
+                // the decimation and the SCR timing in step with real time.
+                num_scr = 0;
+                for (uint32_t i = 0; i < expirations; i++)
                 {
-                    avg_mv += oversampling_buf[i];
+                    if (eda_proc_put_sample(adc_buf, NULL))
+                    {
+                        num_scr++;
+                    }
                 }
 
-                avg_mv /= OVERSAMPLING_BUF_SIZE;
+                // The sample was just taken, every held one is a period older
+                now_us = timebase_now_us();
+                eda_proc_sync_time(now_us);
 
-                filtered_sample = fir_filter(avg_mv, filt_sample_buf, filt_coefs, NUM_FILT_COEFS);
+                summary_put_eda(now_us, scr_get_tonic_ns(), num_scr);
+            }
 
-                // Skip filter settling time
-                if (filt_sample_num < NUM_FILT_COEFS)
-                {
-                    filt_sample_num++;
-                }
-                else
-                {
-                    eda_value_ns = mv_to_eda_ns(filtered_sample);
-                    // printk("%d\n", (int) eda_value_ns);
+            PROF_STOP(PROF_STAGE_EDA_LOOP);
+        }
 
-                    ring_buffer_put(&eda_ring_buf, eda_value_ns);
-                }
-            }
+        pm_device_runtime_put(adc_channel.dev);
+    }
+}
+
+// Accumulates raw samples for a pending calibration and applies and stores
+// the result once enough samples are in
+static void eda_cal_put_sample(uint16_t raw)
+{
+    eda_cal_type_t type = (eda_cal_type_t) atomic_get(&cal_request);
+    bool is_auto;
+    eda_cal_t cal;
+    uint32_t avg;
+    uint64_t var;
+    int32_t mv_q;
+    int err;
+
+    cal_sum += raw;
+    cal_sum_sq += (uint64_t) raw * raw;
+    if (++cal_cnt < CAL_NUM_SAMPLES)
+    {
+        return;
+    }
+
+    avg = (cal_sum + CAL_NUM_SAMPLES / 2) / CAL_NUM_SAMPLES;
+    var = (CAL_NUM_SAMPLES * cal_sum_sq - (uint64_t) cal_sum * cal_sum) /
+          ((uint64_t) CAL_NUM_SAMPLES * CAL_NUM_SAMPLES);
+    is_auto = cal_auto;
+    cal_auto = false;
+    cal_sum = 0;
+    cal_sum_sq = 0;
+    cal_cnt = 0;
+
+    // An automatic offset taken with the electrodes on the skin would be
+    // stored and used on every boot. Keep the default until "eda cal offset"
+    // is run with the electrodes open.
+    if (is_auto && (var > CAL_OPEN_MAX_VAR))
+    {
+        LOG_WRN("EDA electrodes not open (variance %u), using the default offset",
+                (unsigned int) var);
+        atomic_set(&cal_request, EDA_CAL_NONE);
+        return;
+    }
+
+    cal = eda_cal;
+
+    if (EDA_CAL_OFFSET == type)
+    {
+        cal.offset = (uint16_t) avg;
+    }
+    else
+    {
+        // Shorted electrodes put the divider reference on the ADC input
+        mv_q = (int32_t) ((avg > cal.offset) ? (avg - cal.offset) : 0) << EDA_CODE_FRAC_BITS;
+        err = adc_raw_to_millivolts_dt(&adc_channel, &mv_q);
+        if ((err < 0) || (mv_q <= 0))
+        {
+            LOG_ERR("EDA gain calibration failed");
+            atomic_set(&cal_request, EDA_CAL_NONE);
+            return;
         }
+
+        cal.gain = (uint32_t) (((uint64_t) EDA_U_REF_MV << (EDA_CODE_FRAC_BITS + EDA_CAL_GAIN_FRAC_BITS)) / mv_q);
+    }
+
+    // Keep the previous calibration rather than store an implausible one
+    if (!eda_cal_is_valid(&cal))
+    {
+        LOG_ERR("EDA calibration rejected, offset %d, gain %d/%d", cal.offset,
+                cal.gain, 1 << EDA_CAL_GAIN_FRAC_BITS);
+        atomic_set(&cal_request, EDA_CAL_NONE);
+        return;
+    }
+
+    eda_cal = cal;
+    LOG_INF("EDA calibrated, offset %d, gain %d/%d", eda_cal.offset,
+            eda_cal.gain, 1 << EDA_CAL_GAIN_FRAC_BITS);
+
+    err = settings_save_one("eda/cal", &eda_cal, sizeof(eda_cal));
+    if (err < 0)
+    {
+        LOG_ERR("Could not store EDA calibration (%d)", err);
     }
+
+    // Restarts averaging and filter settling with the new calibration
+    eda_proc_set_cal(&eda_cal, adc_full_scale_mv);
+
+    atomic_set(&cal_request, EDA_CAL_NONE);
+}
+
+static bool eda_cal_is_valid(const eda_cal_t *p_cal)
+{
+    return (p_cal->offset >= EDA_CAL_DEFAULT_OFFSET - CAL_OFFSET_TOL) &&
+           (p_cal->offset <= EDA_CAL_DEFAULT_OFFSET + CAL_OFFSET_TOL) &&
+           (p_cal->gain >= CAL_GAIN_MIN) && (p_cal->gain <= CAL_GAIN_MAX);
 }
 
-static inline float fir_filter(int32_t new_sample,
-                            int32_t *filt_sample_buf, 
-                            const float *filt_coefs, 
-                            size_t num_coefs)
+static int eda_settings_set(const char *name, size_t len,
+                            settings_read_cb read_cb, void *cb_arg)
 {
-    float filt_sum = 0.0f;
+    const char *next;
+    eda_cal_t cal;
+    ssize_t rc;
+
+    if (settings_name_steq(name, "cal", &next) && !next)
+    {
+        if (len != sizeof(cal))
+        {
+            return -EINVAL;
+        }
 
-    memmove(filt_sample_buf, &filt_sample_buf[1], (num_coefs - 1) * sizeof(int32_t));
-    filt_sample_buf[NUM_FILT_COEFS - 1] = new_sample;
+        rc = read_cb(cb_arg, &cal, sizeof(cal));
+        if (rc < 0)
+        {
+            return (int) rc;
+        }
 
-    for (size_t i = 0; i < NUM_FILT_COEFS; i++)
+        // An implausible calibration is measured again
+        if (!eda_cal_is_valid(&cal))
+        {
+            LOG_WRN("Stored EDA calibration out of range, ignored");
+            return 0;
+        }
+
+        eda_cal = cal;
+        eda_cal_loaded = true;
+
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+#if defined(CONFIG_SHELL)
+
+static int cmd_eda_cal(const struct shell *sh, eda_cal_type_t type)
+{
+    int err = eda_calibrate(type);
+
+    if (-EBUSY == err)
     {
-        filt_sum += filt_coefs[i] * filt_sample_buf[i];
+        shell_error(sh, "A calibration is already pending");
+        return err;
     }
 
-    return filt_sum;
+    shell_print(sh, "Calibrating on the next %u samples while sampling runs, keep the electrodes %s",
+                CAL_NUM_SAMPLES, (EDA_CAL_OFFSET == type) ? "open" : "shorted");
+
+    return err;
+}
+
+static int cmd_eda_cal_offset(const struct shell *sh, size_t argc, char **argv)
+{
+    return cmd_eda_cal(sh, EDA_CAL_OFFSET);
 }
 
-// Convert value from ADC in mV to skin conductance value in nS
-static inline float mv_to_eda_ns(float mv)
+static int cmd_eda_cal_gain(const struct shell *sh, size_t argc, char **argv)
 {
-    const float r_403 = 200000.0f;
-    const float a_u_ref = 0.5f;
-    float rs = r_403 * ((a_u_ref / (mv / 1000.0f)) - 1.0f);
-    return (1.0e9f / rs);
+    return cmd_eda_cal(sh, EDA_CAL_GAIN);
 }
+
+SHELL_STATIC_SUBCMD_SET_CREATE(eda_cal_cmds,
+    SHELL_CMD(offset, NULL, "Calibrate the offset with open electrodes", cmd_eda_cal_offset),
+    SHELL_CMD(gain, NULL, "Calibrate the gain with shorted electrodes", cmd_eda_cal_gain),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(eda_cmds,
+    SHELL_CMD(cal, &eda_cal_cmds, "Calibrate and store the result", NULL),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(eda, &eda_cmds, "EDA", NULL);
+
+#endif /* CONFIG_SHELL */
\ No newline at end of file
@@ -0,0 +1,380 @@
+/**
+ * EDA processing core: averaging, filtering and conversion of the raw ADC
+ * codes to skin conductance, and the EDA features derived from it.
+ *
+ * Knows nothing about the ADC or the sampling thread, raw samples are pushed
+ * in one by one with eda_proc_put_sample(). Only needs mutexes and logging
+ * from the OS, so it also builds on the host for the replay tool.
+*/
+
+#include "eda_proc.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+#include <math.h>
+
+#include "ring_buffer.h"
+#include "prof.h"
+#include "metrics.h"
+#include "timebase.h"
+#include "eda_fir.h"
+#include "eda_proc_test.h"
+
+#define OVERSAMPLING_BUF_SIZE CONFIG_APP_EDA_DECIMATION
+#define EDA_BUF_SIZE 100
+
+#define NUM_FILT_COEFS EDA_FIR_NUM_TAPS
+
+// Code to conductance table, one entry every 2^EDA_LUT_STEP_BITS codes over
+// the full ADC range
+#define EDA_LUT_STEP_BITS 4
+#define EDA_LUT_SIZE ((1 << (EDA_ADC_RESOLUTION_BITS - EDA_LUT_STEP_BITS)) + 1)
+
+// Conductance reported at and beyond the divider reference voltage
+#define EDA_NS_MAX 100000U
+
+BUILD_ASSERT(1000 % CONFIG_APP_EDA_SAMPLE_RATE_HZ == 0,
+             "EDA sample period is not a whole number of milliseconds");
+
+LOG_MODULE_REGISTER(eda_proc, CONFIG_APP_LOG_LEVEL);
+
+// The helpers below are linked into the benchmarks with the test hooks on
+#if defined(CONFIG_APP_EDA_TEST_HOOKS)
+#define EDA_PROC_STATIC
+#else
+#define EDA_PROC_STATIC static inline
+#endif
+
+static void eda_publish_metrics(int64_t ts_us);
+EDA_PROC_STATIC int32_t fir_filter(int32_t new_sample,
+                                   int32_t *filt_sample_buf,
+                                   const int32_t *filt_coefs,
+                                   size_t num_coefs);
+EDA_PROC_STATIC float mv_to_eda_ns(float mv);
+static void eda_lut_init(int32_t full_scale_mv);
+EDA_PROC_STATIC uint32_t code_to_eda_ns(int32_t code);
+
+static uint32_t oversampling_sum;
+static size_t oversampling_cnt;
+
+static uint64_t sample_cnt;
+static timebase_clock_t eda_clock;
+
+static uint32_t eda_lut[EDA_LUT_SIZE];
+
+static eda_cal_t eda_cal = {
+    .gain = 1 << EDA_CAL_GAIN_FRAC_BITS,
+    .offset = EDA_CAL_DEFAULT_OFFSET,
+};
+
+static float eda_buf[EDA_BUF_SIZE];
+static size_t eda_min_pos[EDA_BUF_SIZE];
+static size_t eda_max_pos[EDA_BUF_SIZE];
+static ring_buffer_t eda_ring_buf;
+
+// Positive changes between consecutive samples of the window, their sum is
+// the EPC. One entry less than the window, so both slide together.
+static float eda_rise_buf[EDA_BUF_SIZE - 1];
+static ring_buffer_t eda_rise_ring_buf;
+static float eda_prev_ns;
+
+// Symmetric low-pass, designed for the decimated sample rate when building.
+// Only the first half and the centre tap are kept.
+static const int32_t filt_coefs[EDA_FIR_NUM_FOLDED] = EDA_FIR_COEFS_FOLDED_Q;
+
+static int32_t filt_sample_buf[NUM_FILT_COEFS];
+static size_t filt_sample_num;
+
+// Sets up the buffers and the SCR detector once, before the first sampling
+int eda_proc_init(void)
+{
+    int err;
+
+    err = ring_buffer_init(&eda_ring_buf, eda_buf, EDA_BUF_SIZE);
+    if (err < 0)
+    {
+        LOG_ERR("Failed to init EDA ring buffer");
+        return err;
+    }
+
+    err = ring_buffer_enable_min_max(&eda_ring_buf, eda_min_pos, eda_max_pos);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    err = ring_buffer_init(&eda_rise_ring_buf, eda_rise_buf, EDA_BUF_SIZE - 1);
+    if (err < 0)
+    {
+        LOG_ERR("Failed to init EPC ring buffer");
+        return err;
+    }
+
+    err = scr_init();
+    if (err < 0)
+    {
+        return err;
+    }
+
+    return eda_proc_reset();
+}
+
+// Brings the averaging, the filter and the SCR detector back to their
+// initial state, so a restart does not mix old and new samples
+int eda_proc_reset(void)
+{
+    int err;
+
+    oversampling_sum = 0;
+    oversampling_cnt = 0;
+    memset(filt_sample_buf, 0, NUM_FILT_COEFS * sizeof(int32_t));
+    filt_sample_num = 0;
+    sample_cnt = 0;
+
+    err = timebase_clock_init(&eda_clock, EDA_SAMPLE_PERIOD_MS * 1000U);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    ring_buffer_clear(&eda_ring_buf);
+    ring_buffer_clear(&eda_rise_ring_buf);
+
+    return scr_reset();
+}
+
+// Applies a new calibration. full_scale_mv is the ADC input at a code of
+// 2^EDA_ADC_RESOLUTION_BITS, as given by adc_raw_to_millivolts(). Averaging
+// and filter settling restart, since the old samples used the old offset.
+void eda_proc_set_cal(const eda_cal_t *p_cal, int32_t full_scale_mv)
+{
+    eda_cal = *p_cal;
+    eda_lut_init(full_scale_mv);
+
+    oversampling_sum = 0;
+    oversampling_cnt = 0;
+    filt_sample_num = 0;
+}
+
+// Anchors the sample clock to the shared timebase, right after the ADC was
+// read
+void eda_proc_sync_time(int64_t now_us)
+{
+    timebase_clock_sync(&eda_clock, sample_cnt, now_us);
+}
+
+// Processes one raw ADC sample. Returns true and fills in p_event if an SCR
+// was detected.
+bool eda_proc_put_sample(uint16_t raw, scr_event_t *p_event)
+{
+    int32_t avg_code;
+    int32_t filtered_sample;
+    int64_t ts_us;
+    float eda_value_ns;
+    scr_event_t scr_event;
+    bool scr_detected = false;
+
+    sample_cnt++;
+
+    if (raw >= eda_cal.offset)
+    {
+        raw = raw - eda_cal.offset;
+    }
+    else
+    {
+        raw = 0;
+    }
+
+    // Average raw codes, conversion to conductance happens once per
+    // decimated sample through the lookup table
+    oversampling_sum += raw;
+    if (++oversampling_cnt >= OVERSAMPLING_BUF_SIZE)
+    {
+        avg_code = (int32_t) ((oversampling_sum << EDA_CODE_FRAC_BITS) / OVERSAMPLING_BUF_SIZE);
+        oversampling_sum = 0;
+        oversampling_cnt = 0;
+
+        PROF_START(PROF_STAGE_FIR_FILTER);
+        filtered_sample = fir_filter(avg_code, filt_sample_buf, filt_coefs, NUM_FILT_COEFS);
+        PROF_STOP(PROF_STAGE_FIR_FILTER);
+
+        // Skip filter settling time
+        if (filt_sample_num < NUM_FILT_COEFS)
+        {
+            filt_sample_num++;
+        }
+        else
+        {
+            // The filtered sample belongs to the middle of the averaged
+            // block, delayed by the filter. Positions are in half samples.
+            ts_us = timebase_clock_get_us(&eda_clock,
+                                          2 * (int64_t) sample_cnt - (OVERSAMPLING_BUF_SIZE - 1) -
+                                          2 * EDA_FIR_GROUP_DELAY * OVERSAMPLING_BUF_SIZE,
+                                          1);
+
+            eda_value_ns = (float) code_to_eda_ns(filtered_sample);
+            // printk("%d\n", (int) eda_value_ns);
+
+            if (ring_buffer_get_num_items(&eda_ring_buf) > 0)
+            {
+                ring_buffer_put(&eda_rise_ring_buf, MAX(eda_value_ns - eda_prev_ns, 0.0f));
+            }
+            ring_buffer_put(&eda_ring_buf, eda_value_ns);
+            eda_prev_ns = eda_value_ns;
+
+            scr_detected = scr_put_sample(eda_value_ns, &scr_event);
+            if (scr_detected)
+            {
+                LOG_DBG("SCR: %d nS, rise %d ms",
+                        (int) scr_event.amplitude_ns,
+                        scr_event.rise_time_ms);
+
+                if (p_event)
+                {
+                    // The peak was the previous sample, the onset rise_time
+                    // before it
+                    *p_event = scr_event;
+                    p_event->ts_us = ts_us - (scr_event.rise_time_ms + EDA_DECIMATED_PERIOD_MS) * 1000LL;
+                }
+            }
+
+            eda_publish_metrics(ts_us);
+        }
+    }
+
+    return scr_detected;
+}
+
+// Sum of the positive EDA changes over the window
+uint32_t eda_get_epc(void)
+{
+    float epc;
+    PROF_START(PROF_STAGE_EPC);
+
+    ring_buffer_sum(&eda_rise_ring_buf, &epc);
+
+    PROF_STOP(PROF_STAGE_EPC);
+
+    return (uint32_t) roundf(MAX(epc, 0.0f));
+}
+
+// Difference between the highest and lowest conductance in the window
+uint32_t eda_get_range_ns(void)
+{
+    float eda_min;
+    float eda_max;
+
+    ring_buffer_min(&eda_ring_buf, &eda_min);
+    ring_buffer_max(&eda_ring_buf, &eda_max);
+
+    return (uint32_t) roundf(eda_max - eda_min);
+}
+
+// Publishes a consistent snapshot of the EDA features, once per decimated
+// sample
+static void eda_publish_metrics(int64_t ts_us)
+{
+    metrics_eda_t metrics;
+
+    metrics.ts_us = ts_us;
+
+    metrics.epc = (uint16_t) MIN(eda_get_epc(), UINT16_MAX);
+    metrics.tonic_ns = (uint16_t) MIN(scr_get_tonic_ns(), UINT16_MAX);
+    metrics.range_ns = (uint16_t) MIN(eda_get_range_ns(), UINT16_MAX);
+    metrics.scr_per_min = (uint8_t) MIN(scr_get_rate_per_min(), UINT8_MAX);
+    metrics.reserved = 0;
+
+    metrics_publish(METRICS_TOPIC_EDA, &metrics, sizeof(metrics));
+}
+
+// Filters averaged codes with folded fixed point taps. The samples that share
+// a coefficient are added first, which halves the multiplies, and there is no
+// float math in the path.
+EDA_PROC_STATIC int32_t fir_filter(int32_t new_sample,
+                                   int32_t *filt_sample_buf,
+                                   const int32_t *filt_coefs,
+                                   size_t num_coefs)
+{
+    const size_t centre = num_coefs / 2;
+    int64_t filt_sum;
+
+    memmove(filt_sample_buf, &filt_sample_buf[1], (num_coefs - 1) * sizeof(int32_t));
+    filt_sample_buf[num_coefs - 1] = new_sample;
+
+    filt_sum = (int64_t) filt_coefs[centre] * filt_sample_buf[centre];
+
+    for (size_t i = 0; i < centre; i++)
+    {
+        filt_sum += (int64_t) filt_coefs[i] *
+                    (filt_sample_buf[i] + filt_sample_buf[num_coefs - 1 - i]);
+    }
+
+    return (int32_t) ((filt_sum + (1 << (EDA_FIR_FRAC_BITS - 1))) >> EDA_FIR_FRAC_BITS);
+}
+
+// Builds the ADC code to conductance table from the calibrated ADC reference.
+// All the float math of the conversion happens here, once.
+static void eda_lut_init(int32_t full_scale_mv)
+{
+    int32_t mv_q;
+    float mv;
+    float eda_ns;
+
+    for (size_t i = 0; i < EDA_LUT_SIZE; i++)
+    {
+        // Same conversion as adc_raw_to_millivolts(), with fractional bits
+        mv_q = (int32_t) (((int64_t) ((i << EDA_LUT_STEP_BITS) << EDA_CODE_FRAC_BITS) *
+                           full_scale_mv) >> EDA_ADC_RESOLUTION_BITS);
+
+        mv = (float) mv_q * eda_cal.gain / (1 << (EDA_CODE_FRAC_BITS + EDA_CAL_GAIN_FRAC_BITS));
+        eda_ns = mv_to_eda_ns(mv);
+
+        if ((mv <= 0.0f) || (eda_ns < 0.0f) || (eda_ns > EDA_NS_MAX))
+        {
+            // Above the divider reference the formula is no longer valid
+            eda_lut[i] = (mv <= 0.0f) ? 0 : EDA_NS_MAX;
+        }
+        else
+        {
+            eda_lut[i] = (uint32_t) roundf(eda_ns);
+        }
+    }
+}
+
+// Convert an averaged ADC code with EDA_CODE_FRAC_BITS fractional bits to skin
+// conductance in nS by linear interpolation in the lookup table
+EDA_PROC_STATIC uint32_t code_to_eda_ns(int32_t code)
+{
+    const int32_t frac_bits = EDA_LUT_STEP_BITS + EDA_CODE_FRAC_BITS;
+    int32_t idx;
+    int32_t frac;
+    int32_t lo;
+    int32_t hi;
+
+    if (code <= 0)
+    {
+        return eda_lut[0];
+    }
+
+    idx = code >> frac_bits;
+    if (idx >= EDA_LUT_SIZE - 1)
+    {
+        return eda_lut[EDA_LUT_SIZE - 1];
+    }
+
+    frac = code & ((1 << frac_bits) - 1);
+    lo = (int32_t) eda_lut[idx];
+    hi = (int32_t) eda_lut[idx + 1];
+
+    return (uint32_t) (lo + (((hi - lo) * frac) >> frac_bits));
+}
+
+// Convert value from ADC in mV to skin conductance value in nS
+EDA_PROC_STATIC float mv_to_eda_ns(float mv)
+{
+    const float r_403 = 200000.0f;
+    const float a_u_ref = EDA_U_REF_MV / 1000.0f;
+    float rs = r_403 * ((a_u_ref / (mv / 1000.0f)) - 1.0f);
+    return (1.0e9f / rs);
+}
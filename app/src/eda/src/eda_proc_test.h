@@ -0,0 +1,20 @@
+#ifndef _EDA_PROC_TEST_H_
+#define _EDA_PROC_TEST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Internal helpers of eda_proc.c, non-static with CONFIG_APP_EDA_TEST_HOOKS
+// so the benchmarks can time them. Not part of the EDA processing API.
+#if defined(CONFIG_APP_EDA_TEST_HOOKS)
+
+int32_t fir_filter(int32_t new_sample,
+                   int32_t *filt_sample_buf,
+                   const int32_t *filt_coefs,
+                   size_t num_coefs);
+float mv_to_eda_ns(float mv);
+uint32_t code_to_eda_ns(int32_t code);
+
+#endif /* CONFIG_APP_EDA_TEST_HOOKS */
+
+#endif /* _EDA_PROC_TEST_H_ */
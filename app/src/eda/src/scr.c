@@ -0,0 +1,182 @@
+/**
+ * Streaming tonic/phasic decomposition of the EDA signal and skin conductance
+ * response (SCR) detection.
+ *
+ * The tonic level is tracked by a baseline that follows the signal down
+ * quickly and up slowly, so it stays under the SCRs and settles onto the
+ * slow drift. The phasic component is the signal above that baseline.
+ *
+ * An SCR starts when the signal rises faster than SCR_ONSET_SLOPE_NS, its
+ * peak is the first sample after that where the signal stops rising, and it
+ * is counted if the rise from onset to peak is at least SCR_MIN_AMP_NS.
+ *
+ * The rate over the last minute is kept in RATE_NUM_BINS counters, so the
+ * cost per sample and the memory are constant.
+*/
+
+#include "scr.h"
+
+#include <zephyr/kernel.h>
+#include <math.h>
+
+// Decimated rate, 10 Hz by default
+#define SAMPLE_PERIOD_MS (1000 * CONFIG_APP_EDA_DECIMATION / CONFIG_APP_EDA_SAMPLE_RATE_HZ)
+
+BUILD_ASSERT((1000 * CONFIG_APP_EDA_DECIMATION) % CONFIG_APP_EDA_SAMPLE_RATE_HZ == 0,
+             "Decimated EDA period is not a whole number of milliseconds");
+
+// Baseline tracking weights per sample for a falling and a rising signal,
+// ~1 s and ~50 s time constants
+#define TONIC_ALPHA_DOWN (SAMPLE_PERIOD_MS / 1000.0f)
+#define TONIC_ALPHA_UP (SAMPLE_PERIOD_MS / 50000.0f)
+
+// Minimum rise per sample that starts an SCR, 0.05 uS/s
+#define SCR_ONSET_SLOPE_NS (50.0f * SAMPLE_PERIOD_MS / 1000.0f)
+
+// Minimum onset to peak rise counted as an SCR
+#define SCR_MIN_AMP_NS 10.0f
+
+// Longest rise accepted as an SCR, 5 s, longer rises are tonic drift
+#define SCR_MAX_RISE_SAMPLES (5000 / SAMPLE_PERIOD_MS)
+
+#define RATE_BIN_SAMPLES (10000 / SAMPLE_PERIOD_MS) // 10 s
+#define RATE_NUM_BINS 6      // 60 s window
+
+static bool have_last_sample;
+static float last_sample;
+static float tonic;
+
+static bool rising;
+static float onset_value;
+static uint32_t rise_samples;
+
+static uint16_t rate_bins[RATE_NUM_BINS];
+static size_t rate_bin_idx;
+static uint32_t rate_bin_samples;
+
+static struct k_mutex scr_mutex;
+
+int scr_init(void)
+{
+    k_mutex_init(&scr_mutex);
+
+    return scr_reset();
+}
+
+// Forgets the tonic level and the SCRs counted so far
+int scr_reset(void)
+{
+    k_mutex_lock(&scr_mutex, K_FOREVER);
+
+    have_last_sample = false;
+    tonic = 0.0f;
+    rising = false;
+    memset(rate_bins, 0, sizeof(rate_bins));
+    rate_bin_idx = 0;
+    rate_bin_samples = 0;
+
+    k_mutex_unlock(&scr_mutex);
+
+    return 0;
+}
+
+// Returns 1 and fills p_event when the sample completes an SCR, 0 otherwise
+int scr_put_sample(float eda_ns, scr_event_t *p_event)
+{
+    int ret = 0;
+    float delta;
+
+    k_mutex_lock(&scr_mutex, K_FOREVER);
+
+    if (!have_last_sample)
+    {
+        last_sample = eda_ns;
+        tonic = eda_ns;
+        have_last_sample = true;
+    }
+
+    if (eda_ns < tonic)
+    {
+        tonic += TONIC_ALPHA_DOWN * (eda_ns - tonic);
+    }
+    else
+    {
+        tonic += TONIC_ALPHA_UP * (eda_ns - tonic);
+    }
+
+    delta = eda_ns - last_sample;
+
+    if (!rising)
+    {
+        if (delta > SCR_ONSET_SLOPE_NS)
+        {
+            rising = true;
+            onset_value = last_sample;
+            rise_samples = 1;
+        }
+    }
+    else if (delta > 0.0f)
+    {
+        rise_samples++;
+        if (rise_samples > SCR_MAX_RISE_SAMPLES)
+        {
+            rising = false;
+        }
+    }
+    else
+    {
+        // Previous sample was the peak
+        rising = false;
+
+        if ((last_sample - onset_value) >= SCR_MIN_AMP_NS)
+        {
+            rate_bins[rate_bin_idx]++;
+
+            if (p_event)
+            {
+                p_event->amplitude_ns = last_sample - onset_value;
+                p_event->rise_time_ms = rise_samples * SAMPLE_PERIOD_MS;
+            }
+            ret = 1;
+        }
+    }
+
+    last_sample = eda_ns;
+
+    if (++rate_bin_samples >= RATE_BIN_SAMPLES)
+    {
+        rate_bin_samples = 0;
+        rate_bin_idx = (rate_bin_idx + 1) % RATE_NUM_BINS;
+        rate_bins[rate_bin_idx] = 0;
+    }
+
+    k_mutex_unlock(&scr_mutex);
+
+    return ret;
+}
+
+uint32_t scr_get_tonic_ns(void)
+{
+    float tonic_ns;
+
+    k_mutex_lock(&scr_mutex, K_FOREVER);
+    tonic_ns = tonic;
+    k_mutex_unlock(&scr_mutex);
+
+    return (tonic_ns > 0.0f) ? (uint32_t) roundf(tonic_ns) : 0;
+}
+
+// Number of SCRs in the last minute
+uint32_t scr_get_rate_per_min(void)
+{
+    uint32_t rate = 0;
+
+    k_mutex_lock(&scr_mutex, K_FOREVER);
+    for (size_t i = 0; i < RATE_NUM_BINS; i++)
+    {
+        rate += rate_bins[i];
+    }
+    k_mutex_unlock(&scr_mutex);
+
+    return rate;
+}
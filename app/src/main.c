@@ -4,41 +4,185 @@
 #include "bt.h"
 #include "ppg.h"
 #include "eda.h"
+#include "metrics.h"
+#include "report.h"
+#include "summary.h"
+#include "prof.h"
 
-#define MSG_PERIOD_MS (1000U)
+#define MSG_PERIOD_MS (CONFIG_APP_REPORT_PERIOD_MS)
+
+BUILD_ASSERT(BT_PAYLOAD_LEN <= REPORT_MSG_MAX_LEN,
+	     "Payload does not fit the reporting policy buffer");
 
 LOG_MODULE_REGISTER(main, CONFIG_APP_LOG_LEVEL);
 
 static void bt_connected_cb(void);
+static void bt_disconnected_cb(void);
 static void send_tmr_cb(struct k_timer *p_tmr);
+static void send_work_handler(struct k_work *p_work);
+#if defined(CONFIG_APP_BT_BROADCAST)
+static void broadcast_update(const uint8_t *p_msg);
+#endif
 
 K_TIMER_DEFINE(send_tmr, send_tmr_cb, NULL);
+K_WORK_DEFINE(send_work, send_work_handler);
+
+#if defined(CONFIG_APP_BACKGROUND_MODE)
+BUILD_ASSERT(CONFIG_APP_BACKGROUND_ON_S < CONFIG_APP_BACKGROUND_PERIOD_S,
+	     "Background sampling window must be shorter than its period");
+
+static void background_work_handler(struct k_work *p_work);
+
+K_WORK_DELAYABLE_DEFINE(background_work, background_work_handler);
+
+static bool background_sampling;
+#endif /* CONFIG_APP_BACKGROUND_MODE */
+
+// Deadbands and escalation thresholds of the message fields, see
+// send_work_handler() for the layout
+static const report_field_t report_fields[] = {
+	{ .offset = 0,  .size = 1, .deadband = 2,   .escalate = 10 },   // HR
+	{ .offset = 1,  .size = 2, .deadband = 5,   .escalate = 30 },   // RMSSD
+	{ .offset = 3,  .size = 2, .deadband = 50,  .escalate = 500 },  // PPG amplitude
+	{ .offset = 5,  .size = 2, .deadband = 20,  .escalate = 200 },  // EPC
+	{ .offset = 7,  .size = 2, .deadband = 50,  .escalate = 500 },  // LF power
+	{ .offset = 9,  .size = 2, .deadband = 50,  .escalate = 500 },  // HF power
+	{ .offset = 11, .size = 2, .deadband = 20,  .escalate = 200 },  // LF/HF ratio
+	{ .offset = 13, .size = 1, .deadband = 1,   .escalate = 3 },    // SpO2
+	{ .offset = 14, .size = 1, .deadband = 10,  .escalate = 40 },   // SQI
+	{ .offset = 15, .size = 2, .deadband = 100, .escalate = 1000 }, // EDA tonic level
+	{ .offset = 17, .size = 1, .deadband = 1,   .escalate = 3 },    // SCRs per minute
+	{ .offset = 18, .size = 1, .deadband = 2,   .escalate = 8 },    // Respiratory rate
+	{ .offset = 19, .size = 1, .deadband = 1,   .escalate = 3 },    // Respiratory rate quality
+};
 
 int main(void)
 {
+	int err;
+
 	LOG_INF("App start");
 	ppg_init();
 	eda_init();
-	
-	bt_start(bt_connected_cb);
-	bt_connected_cb();
+	summary_init();
+
+	// Without the policy no message would ever be sent
+	err = report_init(report_fields, ARRAY_SIZE(report_fields), BT_PAYLOAD_LEN);
+	if (err) {
+		LOG_ERR("Report policy init failed (err %d)", err);
+		return err;
+	}
+
+	bt_start(bt_connected_cb, bt_disconnected_cb);
+
+#if defined(CONFIG_APP_BT_BROADCAST)
+	// Observers may be listening at any time
+	ppg_start_sampling();
+	eda_start_sampling();
+	k_timer_start(&send_tmr, K_MSEC(MSG_PERIOD_MS), K_MSEC(MSG_PERIOD_MS));
+#elif defined(CONFIG_APP_BACKGROUND_MODE)
+	k_work_schedule(&background_work, K_NO_WAIT);
+#endif
 
 	return 0;
 }
 
 static void bt_connected_cb(void)
 {
+#if defined(CONFIG_APP_BT_BROADCAST)
+	// Sampling never stops while broadcasting
+	report_reset();
+#else
+#if defined(CONFIG_APP_BACKGROUND_MODE)
+	k_work_cancel_delayable(&background_work);
+	background_sampling = false;
+#endif
+
+	// Stopping first makes the sampling threads restart from a clean state
+	// if a background window was in progress
+	ppg_stop_sampling();
+	eda_stop_sampling();
+
+	report_reset();
 	ppg_start_sampling();
 	eda_start_sampling();
 	k_timer_start(&send_tmr, K_MSEC(MSG_PERIOD_MS), K_MSEC(MSG_PERIOD_MS));
+#endif /* CONFIG_APP_BT_BROADCAST */
+}
+
+// Nobody is listening, so the sensors are powered down until the next
+// connection or background window
+static void bt_disconnected_cb(void)
+{
+#if !defined(CONFIG_APP_BT_BROADCAST)
+	k_timer_stop(&send_tmr);
+	ppg_stop_sampling();
+	eda_stop_sampling();
+
+#if defined(CONFIG_APP_BACKGROUND_MODE)
+	background_sampling = false;
+	k_work_schedule(&background_work,
+			K_SECONDS(CONFIG_APP_BACKGROUND_PERIOD_S - CONFIG_APP_BACKGROUND_ON_S));
+#endif
+#endif /* !CONFIG_APP_BT_BROADCAST */
+}
+
+#if defined(CONFIG_APP_BACKGROUND_MODE)
+// Alternates between sampling for CONFIG_APP_BACKGROUND_ON_S and staying
+// powered down for the rest of the period. The results are published to
+// the metrics registry as usual, but not sent.
+static void background_work_handler(struct k_work *p_work)
+{
+	if (background_sampling)
+	{
+		ppg_stop_sampling();
+		eda_stop_sampling();
+		background_sampling = false;
+
+		k_work_schedule(&background_work,
+				K_SECONDS(CONFIG_APP_BACKGROUND_PERIOD_S - CONFIG_APP_BACKGROUND_ON_S));
+	}
+	else
+	{
+		ppg_start_sampling();
+		eda_start_sampling();
+		background_sampling = true;
+
+		k_work_schedule(&background_work, K_SECONDS(CONFIG_APP_BACKGROUND_ON_S));
+	}
 }
+#endif /* CONFIG_APP_BACKGROUND_MODE */
+
+#if defined(CONFIG_APP_BT_BROADCAST)
+// Observers do not cost the device anything, so every new snapshot is
+// broadcast regardless of the reporting policy
+static void broadcast_update(const uint8_t *p_msg)
+{
+	static uint32_t last_ppg_version;
+	static uint32_t last_eda_version;
+	uint32_t ppg_version = metrics_get_version(METRICS_TOPIC_PPG);
+	uint32_t eda_version = metrics_get_version(METRICS_TOPIC_EDA);
+
+	if ((ppg_version != last_ppg_version) || (eda_version != last_eda_version))
+	{
+		bt_broadcast_update(p_msg, BT_PAYLOAD_LEN);
+		last_ppg_version = ppg_version;
+		last_eda_version = eda_version;
+	}
+}
+#endif /* CONFIG_APP_BT_BROADCAST */
 
 static void send_tmr_cb(struct k_timer *p_tmr)
+{
+	// Building and sending the message takes the BT stack locks, which
+	// cannot be done from the timer ISR
+	k_work_submit(&send_work);
+}
+
+static void send_work_handler(struct k_work *p_work)
 {
 	uint8_t msg[BT_PAYLOAD_LEN];
-	uint16_t rmssd;
-	uint16_t ppg_ampl;
-	uint16_t epc;
+	metrics_ppg_t ppg;
+	metrics_eda_t eda;
 
 	/**
 	 * Message bytes:
@@ -49,27 +193,76 @@ static void send_tmr_cb(struct k_timer *p_tmr)
 	 * [4] PPG amplitude high byte
 	 * [5] EPC low byte
 	 * [6] EPC high byte
+	 * [7] LF power low byte
+	 * [8] LF power high byte
+	 * [9] HF power low byte
+	 * [10] HF power high byte
+	 * [11] LF/HF ratio * 100 low byte
+	 * [12] LF/HF ratio * 100 high byte
+	 * [13] SpO2 in %
+	 * [14] PPG signal quality index (0 - 100)
+	 * [15] EDA tonic level low byte
+	 * [16] EDA tonic level high byte
+	 * [17] SCRs in the last minute
+	 * [18] Respiratory rate in breaths per minute
+	 * [19] Respiratory rate quality: 0 none yet, 1 low, 2 good
 	*/
 
-	msg[0] = (uint8_t) ppg_get_hr_bpm();
+	// Each snapshot is consistent within itself, so all PPG values come
+	// from the same beat and all EDA values from the same window
+	metrics_read(METRICS_TOPIC_PPG, &ppg, sizeof(ppg));
+	metrics_read(METRICS_TOPIC_EDA, &eda, sizeof(eda));
+
+	msg[0] = (uint8_t) MIN(ppg.hr_bpm, UINT8_MAX);
+
+	msg[1] = (uint8_t) (ppg.rmssd_ms & 0xFF);
+	msg[2] = (uint8_t) (ppg.rmssd_ms >> 8);
+
+	msg[3] = (uint8_t) (ppg.amplitude & 0xFF);
+	msg[4] = (uint8_t) (ppg.amplitude >> 8);
+
+	msg[5] = (uint8_t) (eda.epc & 0xFF);
+	msg[6] = (uint8_t) (eda.epc >> 8);
+
+	msg[7] = (uint8_t) (ppg.lf_power & 0xFF);
+	msg[8] = (uint8_t) (ppg.lf_power >> 8);
+
+	msg[9] = (uint8_t) (ppg.hf_power & 0xFF);
+	msg[10] = (uint8_t) (ppg.hf_power >> 8);
+
+	msg[11] = (uint8_t) (ppg.lf_hf_ratio & 0xFF);
+	msg[12] = (uint8_t) (ppg.lf_hf_ratio >> 8);
+
+	msg[13] = ppg.spo2_pct;
+
+	msg[14] = ppg.sqi;
+
+	msg[15] = (uint8_t) (eda.tonic_ns & 0xFF);
+	msg[16] = (uint8_t) (eda.tonic_ns >> 8);
+
+	msg[17] = eda.scr_per_min;
 
-	rmssd = (uint16_t) ppg_get_rmssd();
-	msg[1] = (uint8_t) (rmssd & 0xFF);
-	msg[2] = (uint8_t) (rmssd >> 8);
+	msg[18] = ppg.resp_bpm;
+	msg[19] = ppg.resp_quality;
 
-	ppg_ampl = (uint16_t) ppg_get_amplitude();
-	msg[3] = (uint8_t) (ppg_ampl & 0xFF);
-	msg[4] = (uint8_t) (ppg_ampl >> 8);
+#if defined(CONFIG_APP_BT_BROADCAST)
+	broadcast_update(msg);
+#endif
 
-	epc = (uint16_t) eda_get_epc();
-	msg[5] = (uint8_t) (epc & 0xFF);
-	msg[6] = (uint8_t) (epc >> 8);
+	if (!report_should_send(msg))
+	{
+		return;
+	}
 
-	LOG_DBG("Sending message: HR %d, RMSSD %d, PPG ampl %d, EPC %d",
-			msg[0],
-			((uint16_t) msg[2] << 8) | msg[1],
-			((uint16_t) msg[4] << 8) | msg[3],
-			((uint16_t) msg[6] << 8) | msg[5]);
+	LOG_DBG("Sending message: HR %d, RMSSD %d, PPG ampl %d, EPC %d, LF %d, HF %d, LF/HF %d, SpO2 %d, SQI %d, tonic %d, SCR/min %d",
+			ppg.hr_bpm, ppg.rmssd_ms, ppg.amplitude, eda.epc,
+			ppg.lf_power, ppg.hf_power, ppg.lf_hf_ratio, ppg.spo2_pct,
+			ppg.sqi, eda.tonic_ns, eda.scr_per_min);
+	LOG_DBG("PPG ampl SD %d, HR range %d-%d, EDA range %d, resp %d/min (quality %d)",
+			ppg.amplitude_sd, ppg.hr_min_bpm, ppg.hr_max_bpm, eda.range_ns,
+			ppg.resp_bpm, ppg.resp_quality);
 
+	PROF_START(PROF_STAGE_BT_NOTIFY);
 	bt_send_notification(msg, BT_PAYLOAD_LEN);
+	PROF_STOP(PROF_STAGE_BT_NOTIFY);
 }
@@ -0,0 +1,13 @@
+#ifndef _HRV_H_
+#define _HRV_H_
+
+#include <stdint.h>
+
+int hrv_init(void);
+int hrv_reset(void);
+int hrv_put_ibi(float ibi_ms);
+uint32_t hrv_get_lf_power(void);
+uint32_t hrv_get_hf_power(void);
+uint32_t hrv_get_lf_hf_ratio(void);
+
+#endif /* _HRV_H_ */
@@ -3,10 +3,10 @@
 
 #include <stdint.h>
 
+#include "ppg_proc.h"
+
 int ppg_init(void);
 void ppg_start_sampling(void);
-uint32_t ppg_get_hr_bpm(void);
-uint32_t ppg_get_rmssd(void);
-uint32_t ppg_get_amplitude(void);
+void ppg_stop_sampling(void);
 
 #endif /* _PPG_H_ */
\ No newline at end of file
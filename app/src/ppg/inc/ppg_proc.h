@@ -0,0 +1,35 @@
+#ifndef _PPG_PROC_H_
+#define _PPG_PROC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PPG_SAMPLE_PERIOD_MS (1000 / CONFIG_APP_PPG_SAMPLE_RATE_HZ)
+
+// Beat timestamps are kept in sample counts with 8 fractional bits
+#define PPG_BEAT_TS_FRAC_BITS 8
+
+typedef struct ppg_beat
+{
+    int64_t ts_us;      // Peak of the pulse on the shared timebase
+    float ibi_ms;       // 0 for the first beat after a reset
+    uint32_t sqi;       // 0 for the first beat after a reset
+    bool valid;         // Passed the HR range, outlier and SQI checks
+} ppg_beat_t;
+
+int ppg_proc_init(void);
+int ppg_proc_reset(void);
+void ppg_proc_set_resolution(uint8_t bits);
+bool ppg_proc_put_sample(int32_t red, int32_t ir, ppg_beat_t *p_beat);
+void ppg_proc_skip_samples(uint32_t num_samples);
+void ppg_proc_sync_time(int64_t now_us);
+
+uint32_t ppg_get_hr_bpm(void);
+uint32_t ppg_get_rmssd(void);
+uint32_t ppg_get_amplitude(void);
+uint32_t ppg_get_amplitude_sd(void);
+uint32_t ppg_get_hr_min_bpm(void);
+uint32_t ppg_get_hr_max_bpm(void);
+uint32_t ppg_get_sqi(void);
+
+#endif /* _PPG_PROC_H_ */
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef _RESP_H_
+#define _RESP_H_
+
+#include <stdint.h>
+
+typedef enum resp_quality
+{
+    RESP_QUALITY_NONE, // Window not filled yet
+    RESP_QUALITY_LOW,  // Modulations disagree
+    RESP_QUALITY_GOOD,
+} resp_quality_t;
+
+int resp_init(void);
+int resp_reset(void);
+int resp_put_beat(float dt_ms, float amplitude, float baseline, float ibi_ms);
+uint32_t resp_get_rate_bpm(void);
+resp_quality_t resp_get_quality(void);
+
+#endif /* _RESP_H_ */
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef _SPO2_H_
+#define _SPO2_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+int spo2_init(void);
+void spo2_put_sample(int32_t red, int32_t ir);
+void spo2_end_beat(bool valid);
+uint32_t spo2_get_percent(void);
+
+#endif /* _SPO2_H_ */
@@ -0,0 +1,11 @@
+#ifndef _SQI_H_
+#define _SQI_H_
+
+#include <stdint.h>
+
+int sqi_init(void);
+void sqi_put_sample(int32_t ac_sample);
+uint32_t sqi_check_beat(int32_t amplitude, float ibi_ms, float expected_ibi_ms);
+void sqi_accept_beat(void);
+
+#endif /* _SQI_H_ */
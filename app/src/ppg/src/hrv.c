@@ -0,0 +1,197 @@
+/**
+ * Frequency-domain HRV (LF and HF power) computed from the IBI series.
+ *
+ * IBIs arrive at irregular beat times, so they are first resampled onto a
+ * uniform grid by linear interpolation between consecutive beats. Every
+ * resampled point is pushed into a sliding DFT (sdft.c) that only tracks the
+ * bins covering the LF and HF bands.
+ *
+ * Cost is fixed at compile time:
+ * - memory: HRV_WIN_LEN history floats plus 4 floats per tracked bin
+ *   (880 bytes with the defaults below)
+ * - compute: one complex multiply-add per tracked bin per resampled point,
+ *   i.e. HRV_NUM_BINS * HRV_RESAMPLE_HZ updates per second
+ * The cost of every IBI is measured by the hrv_put_ibi profiling stage.
+*/
+
+#include "hrv.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <math.h>
+
+#include "sdft.h"
+
+#define HRV_RESAMPLE_HZ 2
+#define HRV_RESAMPLE_PERIOD_MS (1000.0f / HRV_RESAMPLE_HZ)
+
+#define HRV_WIN_LEN 128 // 64 s window, 1/64 Hz bin spacing
+
+// Band edges as DFT bin indexes, k = f * HRV_WIN_LEN / HRV_RESAMPLE_HZ
+#define LF_FIRST_BIN 3  // 0.047 Hz
+#define LF_LAST_BIN 9   // 0.141 Hz
+#define HF_FIRST_BIN 10 // 0.156 Hz
+#define HF_LAST_BIN 25  // 0.391 Hz
+
+#define HRV_NUM_BINS (HF_LAST_BIN - LF_FIRST_BIN + 1)
+
+// Running mean removed from the IBIs before they enter the DFT
+#define MEAN_ALPHA 0.01f
+
+LOG_MODULE_REGISTER(hrv, CONFIG_APP_LOG_LEVEL);
+
+static void hrv_push(float x);
+static float band_power(size_t first_bin, size_t last_bin);
+
+static float hist_buf[HRV_WIN_LEN];
+static float bins_buf[SDFT_BINS_LEN(HRV_NUM_BINS)];
+static sdft_t hrv_sdft;
+
+static bool have_last_ibi;
+static float last_ibi;
+static float mean_ibi;
+static float grid_pos_ms;
+
+static float lf_power;
+static float hf_power;
+
+static struct k_mutex hrv_mutex;
+
+int hrv_init(void)
+{
+    int err;
+
+    err = sdft_init(&hrv_sdft, hist_buf, HRV_WIN_LEN, bins_buf, LF_FIRST_BIN, HRV_NUM_BINS);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    k_mutex_init(&hrv_mutex);
+
+    LOG_DBG("HRV engine uses %u bytes, %u bins at %u Hz",
+            (unsigned int) (sizeof(hist_buf) + sizeof(bins_buf)),
+            HRV_NUM_BINS, HRV_RESAMPLE_HZ);
+
+    return hrv_reset();
+}
+
+// Empties the window, the band powers are withdrawn until it is filled again
+int hrv_reset(void)
+{
+    sdft_clear(&hrv_sdft);
+
+    have_last_ibi = false;
+    grid_pos_ms = 0.0f;
+
+    k_mutex_lock(&hrv_mutex, K_FOREVER);
+    lf_power = 0.0f;
+    hf_power = 0.0f;
+    k_mutex_unlock(&hrv_mutex);
+
+    return 0;
+}
+
+int hrv_put_ibi(float ibi_ms)
+{
+    float lf;
+    float hf;
+
+    if (ibi_ms <= 0.0f)
+    {
+        return -1;
+    }
+
+    if (!have_last_ibi)
+    {
+        last_ibi = ibi_ms;
+        mean_ibi = ibi_ms;
+        have_last_ibi = true;
+        return 0;
+    }
+
+    // The previous beat sits at time 0 and this one at ibi_ms. Emit every
+    // grid point in between, interpolated between the two IBI values.
+    while (grid_pos_ms <= ibi_ms)
+    {
+        hrv_push(last_ibi + (ibi_ms - last_ibi) * (grid_pos_ms / ibi_ms));
+        grid_pos_ms += HRV_RESAMPLE_PERIOD_MS;
+    }
+
+    grid_pos_ms -= ibi_ms;
+    last_ibi = ibi_ms;
+
+    if (!sdft_is_full(&hrv_sdft))
+    {
+        return 0;
+    }
+
+    lf = band_power(LF_FIRST_BIN, LF_LAST_BIN);
+    hf = band_power(HF_FIRST_BIN, HF_LAST_BIN);
+
+    k_mutex_lock(&hrv_mutex, K_FOREVER);
+    lf_power = lf;
+    hf_power = hf;
+    k_mutex_unlock(&hrv_mutex);
+
+    return 0;
+}
+
+// LF power in ms^2
+uint32_t hrv_get_lf_power(void)
+{
+    float lf;
+
+    k_mutex_lock(&hrv_mutex, K_FOREVER);
+    lf = lf_power;
+    k_mutex_unlock(&hrv_mutex);
+
+    return (uint32_t) roundf(lf);
+}
+
+// HF power in ms^2
+uint32_t hrv_get_hf_power(void)
+{
+    float hf;
+
+    k_mutex_lock(&hrv_mutex, K_FOREVER);
+    hf = hf_power;
+    k_mutex_unlock(&hrv_mutex);
+
+    return (uint32_t) roundf(hf);
+}
+
+// LF/HF ratio multiplied by 100
+uint32_t hrv_get_lf_hf_ratio(void)
+{
+    float ratio = 0.0f;
+
+    k_mutex_lock(&hrv_mutex, K_FOREVER);
+    if (hf_power > 0.0f)
+    {
+        ratio = 100.0f * lf_power / hf_power;
+    }
+    k_mutex_unlock(&hrv_mutex);
+
+    return (uint32_t) roundf(ratio);
+}
+
+// Removes the running mean before the point enters the DFT
+static void hrv_push(float x)
+{
+    mean_ibi += MEAN_ALPHA * (x - mean_ibi);
+    sdft_push(&hrv_sdft, x - mean_ibi);
+}
+
+// One-sided periodogram power summed over [first_bin, last_bin], in ms^2
+static float band_power(size_t first_bin, size_t last_bin)
+{
+    float sum = 0.0f;
+
+    for (size_t k = first_bin; k <= last_bin; k++)
+    {
+        sum += sdft_power(&hrv_sdft, k);
+    }
+
+    return 2.0f * sum / ((float) HRV_WIN_LEN * HRV_WIN_LEN);
+}
@@ -4,27 +4,50 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/devicetree.h>
-#include <math.h>
+#include <zephyr/pm/device_runtime.h>
+#include <drivers/sensor/max3010x.h>
 
-#include "heartRate.h"
-#include "ring_buffer.h"
+#include "prof.h"
+#include "loop_health.h"
+#include "summary.h"
+#include "timebase.h"
 
 #define SMPL_THRD_STACK_SIZE (8192U)
 #define SMPL_THRD_PRIO 3
 
-#define SAMPLE_PERIOD_MS 20 // 50 Hz
-
-#define HR_MOV_AVG_SIZE 4
-#define IBI_MOV_AVG_SIZE 30
-#define AMP_MOV_AVG_SIZE 4
-
-#define HR_MIN 40.0f
-#define HR_MAX 200.0f
+// The sensor buffers samples in its FIFO, the thread wakes up once per batch
+#define WAKEUP_PERIOD_MS (PPG_SAMPLE_PERIOD_MS * CONFIG_APP_PPG_BATCH_SAMPLES)
+
+// MAX30101/MAX30102 samples are left-justified to 18 bits whatever the
+// pulse width, the MAX30100 ones have 16 bits
+#if DT_HAS_COMPAT_STATUS_OKAY(maxim_max30102)
+#define SENSOR_RESOLUTION_BITS 18
+#define SENSOR_FIFO_DEPTH 32
+#define SENSOR_FIFO_ROLLOVER DT_PROP(DT_INST(0, maxim_max30102), fifo_rollover_en)
+#else
+#define SENSOR_RESOLUTION_BITS 16
+#define SENSOR_FIFO_DEPTH 16
+#define SENSOR_FIFO_ROLLOVER 0
+#endif
+
+BUILD_ASSERT(CONFIG_APP_PPG_BATCH_SAMPLES < SENSOR_FIFO_DEPTH,
+             "PPG batch does not fit the sensor FIFO");
+
+// The filters are designed for CONFIG_APP_PPG_SAMPLE_RATE_HZ, which has to be
+// what comes out of the sensor FIFO
+#if DT_HAS_COMPAT_STATUS_OKAY(maxim_max30102)
+BUILD_ASSERT(DT_PROP(DT_INST(0, maxim_max30102), smp_sr) ==
+             CONFIG_APP_PPG_SAMPLE_RATE_HZ * DT_PROP(DT_INST(0, maxim_max30102), smp_ave),
+             "PPG sample rate does not match smp-sr and smp-ave");
+#else
+BUILD_ASSERT(50 == CONFIG_APP_PPG_SAMPLE_RATE_HZ,
+             "The MAX30100 driver samples at 50 Hz");
+#endif
 
 LOG_MODULE_REGISTER(ppg, CONFIG_APP_LOG_LEVEL);
 
 static void ppg_smpl_thrd_run(void *p1, void *p2, void *p3);
-static inline float ms_to_bpm(int64_t ms);
+static int ppg_read_sample(uint32_t *p_pending);
 
 static K_THREAD_DEFINE(ppg_smpl_thrd,
                        8192,
@@ -33,18 +56,15 @@ static K_THREAD_DEFINE(ppg_smpl_thrd,
                        SMPL_THRD_PRIO, 0, 0);
 
 static K_TIMER_DEFINE(sampling_tmr, NULL, NULL);
+static K_SEM_DEFINE(start_sem, 0, 1);
 
-static float hr_mov_avg_buf[HR_MOV_AVG_SIZE];
-static ring_buffer_t hr_mov_avg_ring_buf;
-
-static float ibi_mov_avg_buf[IBI_MOV_AVG_SIZE];
-static ring_buffer_t ibi_mov_avg_ring_buf;
+static loop_health_t ppg_loop_health;
 
-static float amp_mov_avg_buf[AMP_MOV_AVG_SIZE];
-static ring_buffer_t amp_mov_avg_ring_buf;
-
-// static const struct device *const p_sensor_dev = DEVICE_DT_GET(DT_NODELABEL(max30101));
+#if DT_HAS_COMPAT_STATUS_OKAY(maxim_max30102)
+static const struct device *const p_sensor_dev = DEVICE_DT_GET_ONE(maxim_max30102);
+#else
 static const struct device *const p_sensor_dev = DEVICE_DT_GET(DT_NODELABEL(max30100));
+#endif
 
 int ppg_init(void)
 {
@@ -56,126 +76,172 @@ int ppg_init(void)
         return -1;
     }
 
-    err = ring_buffer_init(&hr_mov_avg_ring_buf, hr_mov_avg_buf, HR_MOV_AVG_SIZE);
-    if (0 == err)
-    {
-        err = ring_buffer_init(&ibi_mov_avg_ring_buf, ibi_mov_avg_buf, IBI_MOV_AVG_SIZE);
-    }
+    ppg_proc_set_resolution(SENSOR_RESOLUTION_BITS);
+
+    err = ppg_proc_init();
+
     if (0 == err)
     {
-        err = ring_buffer_init(&amp_mov_avg_ring_buf, amp_mov_avg_buf, AMP_MOV_AVG_SIZE);
+        err = loop_health_init(&ppg_loop_health, "ppg", WAKEUP_PERIOD_MS * 1000U);
     }
 
+    PROF_SET_BUDGET_US(PROF_STAGE_PPG_LOOP, WAKEUP_PERIOD_MS * 1000U);
+
     return err;
 }
 
+// Sampling runs in the PPG thread, which powers up the sensor and starts
+// from a clean state
 void ppg_start_sampling(void)
 {
-    k_timer_start(&sampling_tmr, K_MSEC(SAMPLE_PERIOD_MS), K_MSEC(SAMPLE_PERIOD_MS));
-}
-
-uint32_t ppg_get_hr_bpm(void)
-{
-    float bpm;
-    ring_buffer_mov_avg(&hr_mov_avg_ring_buf, &bpm);
-    return (uint32_t) roundf(bpm);
-}
-
-uint32_t ppg_get_rmssd(void)
-{
-    float ibi_buf[IBI_MOV_AVG_SIZE];
-    int num_ibi;
-    float ibi_diff;
-    float ibi_diff_sq_sum = 0.0f;
-    float rmssd;
-
-    if (ring_buffer_get_num_items(&ibi_mov_avg_ring_buf) > 1)
-    {
-        num_ibi = ring_buffer_copy_inorder(&ibi_mov_avg_ring_buf, ibi_buf);
-        
-        for(size_t i = 1; i < num_ibi; i++)
-        {
-            ibi_diff = ibi_buf[i] - ibi_buf[i-1];
-            ibi_diff_sq_sum += ibi_diff * ibi_diff;
-        }
-
-        rmssd = sqrtf(ibi_diff_sq_sum / (num_ibi - 1));
-    }
-    else
-    {
-        rmssd = 0.0f;
-    }
-
-    return (uint32_t) roundf(rmssd);
+    k_sem_give(&start_sem);
 }
 
-uint32_t ppg_get_amplitude(void)
+// The PPG thread notices the stopped timer, finishes the current period
+// and powers the sensor down
+void ppg_stop_sampling(void)
 {
-    float ampl;
-    ring_buffer_mov_avg(&amp_mov_avg_ring_buf, &ampl);
-    return (uint32_t) roundf(ampl);
+    k_timer_stop(&sampling_tmr);
 }
 
 static void ppg_smpl_thrd_run(void *p1, void *p2, void *p3)
 {
-    int ret;
-    struct sensor_value sens_val;
-    static int64_t last_beat_ms = 0;
-    int64_t current_beat_ms;
-    int64_t diff_ms;
-    float bpm;
-    int16_t amplitude;
+    int err;
+    uint32_t expirations;
+    uint32_t pending;
 
     for (;;)
     {
-        k_timer_status_sync(&sampling_tmr); 
+        k_sem_take(&start_sem, K_FOREVER);
 
-        ret = sensor_sample_fetch_chan(p_sensor_dev, SENSOR_CHAN_RED);
-        if (ret != 0)
+        err = pm_device_runtime_get(p_sensor_dev);
+        if (err < 0)
         {
-            LOG_ERR("Failed to fetch PPG sample");
-            return;
+            LOG_ERR("Could not power up PPG sensor (%d)", err);
+            continue;
         }
 
-        ret = sensor_channel_get(p_sensor_dev, SENSOR_CHAN_RED, &sens_val);
-        if (ret != 0)
-        {
-            LOG_ERR("Failed to get PPG sample");
-            return;
-        }
+        ppg_proc_reset();
+        loop_health_restart(&ppg_loop_health);
 
-        // printk("%d\n", sens_val.val1);
+        k_timer_start(&sampling_tmr, K_MSEC(WAKEUP_PERIOD_MS), K_MSEC(WAKEUP_PERIOD_MS));
 
-        if (checkForBeat(sens_val.val1, &amplitude))
+        for (;;)
         {
-            current_beat_ms = k_uptime_get();
+            expirations = k_timer_status_sync(&sampling_tmr); 
 
-            if (last_beat_ms != 0)
+            // No expirations means the timer was stopped
+            if (0 == expirations)
             {
-                diff_ms = current_beat_ms - last_beat_ms;
+                break;
+            }
 
-                bpm = ms_to_bpm(diff_ms);
+            PROF_START(PROF_STAGE_PPG_LOOP);
 
-                // Check if HR is realistic to reduce the effect of missed or
-                // false heart beats
-                if ((bpm > HR_MIN) && (bpm < HR_MAX))
-                {
-                    ring_buffer_put(&hr_mov_avg_ring_buf, bpm);
+            loop_health_wakeup(&ppg_loop_health, expirations);
 
-                    ring_buffer_put(&ibi_mov_avg_ring_buf, (float) diff_ms);
+            // Drain whatever the sensor collected since the last wakeup. The
+            // driver reads the FIFO in one burst and hands out the samples
+            // one by one, so this stops at the end of the burst rather than
+            // issuing another read for samples that arrived in the meantime.
+            do
+            {
+                err = ppg_read_sample(&pending);
+            } while ((0 == err) && (pending > 0));
 
-                    ring_buffer_put(&amp_mov_avg_ring_buf, (float) amplitude);
+            ppg_proc_sync_time(timebase_now_us());
 
-                    // printk("%d\n", (int) bpm);
-                }
+            if ((err != 0) && (err != -ENODATA))
+            {
+                // Power down and wait for the next start
+                k_timer_stop(&sampling_tmr);
             }
 
-            last_beat_ms = current_beat_ms;
+            PROF_STOP(PROF_STAGE_PPG_LOOP);
         }
+
+        pm_device_runtime_put(p_sensor_dev);
     }
 }
 
-static inline float ms_to_bpm(int64_t ms)
+// Reads one sample and hands it to the processing core. Returns -ENODATA if
+// the sensor FIFO is empty.
+static int ppg_read_sample(uint32_t *p_pending)
 {
-    return 60.f / (ms / 1000.f);
-}
+    int ret;
+    struct sensor_value sens_val;
+    struct sensor_value ir_val;
+    struct sensor_value fifo_val;
+    ppg_beat_t beat;
+    uint32_t lost;
+
+    *p_pending = 0;
+
+    ret = sensor_sample_fetch_chan(p_sensor_dev, SENSOR_CHAN_RED);
+    if (-ENODATA == ret)
+    {
+        return ret;
+    }
+    else if (ret != 0)
+    {
+        LOG_ERR("Failed to fetch PPG sample");
+        return ret;
+    }
+
+    ret = sensor_channel_get(p_sensor_dev,
+                             (enum sensor_channel) SENSOR_CHAN_MAX3010X_PENDING,
+                             &fifo_val);
+    if (0 == ret)
+    {
+        *p_pending = (uint32_t) fifo_val.val1;
+
+        // Samples dropped by a FIFO overflow still advance the sample
+        // clock, so the beat timestamps stay right after a late wakeup
+        ret = sensor_channel_get(p_sensor_dev,
+                                 (enum sensor_channel) SENSOR_CHAN_MAX3010X_LOST,
+                                 &fifo_val);
+    }
+    if (ret != 0)
+    {
+        LOG_ERR("Failed to get PPG FIFO state");
+        return ret;
+    }
+
+    lost = (uint32_t) fifo_val.val1;
+
+    ret = sensor_channel_get(p_sensor_dev, SENSOR_CHAN_RED, &sens_val);
+    if (ret != 0)
+    {
+        LOG_ERR("Failed to get PPG sample");
+        return ret;
+    }
+
+    // The IR channel comes with the same FIFO read in SpO2 mode
+    ret = sensor_channel_get(p_sensor_dev, SENSOR_CHAN_IR, &ir_val);
+    if (ret != 0)
+    {
+        LOG_ERR("Failed to get PPG IR sample");
+        return ret;
+    }
+
+    // printk("%d\n", sens_val.val1);
+
+    // The driver reports lost samples with the sample next to the gap, the
+    // first of a burst with rollover and the last one without
+    if (SENSOR_FIFO_ROLLOVER)
+    {
+        ppg_proc_skip_samples(lost);
+    }
+
+    if (ppg_proc_put_sample(sens_val.val1, ir_val.val1, &beat) && beat.valid)
+    {
+        summary_put_beat(beat.ts_us, beat.ibi_ms);
+    }
+
+    if (!SENSOR_FIFO_ROLLOVER)
+    {
+        ppg_proc_skip_samples(lost);
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,471 @@
+/**
+ * PPG processing core: beat detection, HR, HRV, SpO2 and signal quality from
+ * the red and IR samples of the PPG sensor.
+ *
+ * Knows nothing about the sensor or the sampling thread, samples are pushed
+ * in one by one with ppg_proc_put_sample(). Only needs mutexes and logging
+ * from the OS, so it also builds on the host for the replay tool.
+*/
+
+#include "ppg_proc.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <math.h>
+
+#include "heartRate.h"
+#include "hrv.h"
+#include "resp.h"
+#include "spo2.h"
+#include "sqi.h"
+#include "ring_buffer.h"
+#include "median_filter.h"
+#include "prof.h"
+#include "metrics.h"
+#include "timebase.h"
+
+#define HR_MOV_AVG_SIZE 4
+#define IBI_MOV_AVG_SIZE 30
+#define AMP_MOV_AVG_SIZE 4
+#define SQI_MOV_AVG_SIZE 4
+#define IBI_MEDIAN_SIZE 9
+
+// Median needs a few IBIs before it is used to reject outliers
+#define IBI_MEDIAN_MIN_ITEMS 3
+
+#define HR_MIN 40.0f
+#define HR_MAX 200.0f
+
+// Beats with a lower signal quality index are kept out of the metrics
+#define SQI_MIN 50
+
+BUILD_ASSERT(1000 % CONFIG_APP_PPG_SAMPLE_RATE_HZ == 0,
+             "PPG sample period is not a whole number of milliseconds");
+
+LOG_MODULE_REGISTER(ppg_proc, CONFIG_APP_LOG_LEVEL);
+
+static bool is_ibi_outlier(float ibi_ms);
+static void rmssd_visit(const float *p_ibi, size_t num_ibi, void *p_ctx);
+static void ppg_publish_metrics(int64_t ts_us);
+static inline float ms_to_bpm(float ms);
+
+static float hr_mov_avg_buf[HR_MOV_AVG_SIZE];
+static ring_buffer_t hr_mov_avg_ring_buf;
+
+static float ibi_mov_avg_buf[IBI_MOV_AVG_SIZE];
+static size_t ibi_min_pos[IBI_MOV_AVG_SIZE];
+static size_t ibi_max_pos[IBI_MOV_AVG_SIZE];
+static ring_buffer_t ibi_mov_avg_ring_buf;
+
+static float amp_mov_avg_buf[AMP_MOV_AVG_SIZE];
+static ring_buffer_t amp_mov_avg_ring_buf;
+
+static float sqi_mov_avg_buf[SQI_MOV_AVG_SIZE];
+static ring_buffer_t sqi_mov_avg_ring_buf;
+
+static float ibi_median_data[IBI_MEDIAN_SIZE];
+static int ibi_median_pos[IBI_MEDIAN_SIZE];
+static int ibi_median_heap[IBI_MEDIAN_SIZE];
+static median_filter_t ibi_median_filt;
+
+typedef struct rmssd_ctx
+{
+    float prev_ibi;
+    bool have_prev;
+    float diff_sq_sum;
+} rmssd_ctx_t;
+
+static uint32_t sample_cnt;
+static timebase_clock_t ppg_clock;
+static bool have_last_beat;
+static int64_t last_beat_ts;
+
+// Mean red level over the current beat, the baseline seen by the
+// respiration stage
+static int64_t beat_red_sum;
+static uint32_t beat_red_cnt;
+
+static bool have_last_resp_beat;
+static int64_t last_resp_beat_ts;
+
+// Scales the beat detector to the sample resolution of the sensor
+void ppg_proc_set_resolution(uint8_t bits)
+{
+    setBeatDetectorResolution(bits);
+}
+
+// Sets up the buffers and the stages once, before the first sampling
+int ppg_proc_init(void)
+{
+    int err;
+
+    err = ring_buffer_init(&hr_mov_avg_ring_buf, hr_mov_avg_buf, HR_MOV_AVG_SIZE);
+    if (0 == err)
+    {
+        err = ring_buffer_init(&ibi_mov_avg_ring_buf, ibi_mov_avg_buf, IBI_MOV_AVG_SIZE);
+    }
+    if (0 == err)
+    {
+        err = ring_buffer_enable_min_max(&ibi_mov_avg_ring_buf, ibi_min_pos, ibi_max_pos);
+    }
+    if (0 == err)
+    {
+        err = ring_buffer_init(&amp_mov_avg_ring_buf, amp_mov_avg_buf, AMP_MOV_AVG_SIZE);
+    }
+    if (0 == err)
+    {
+        err = ring_buffer_enable_var(&amp_mov_avg_ring_buf);
+    }
+    if (0 == err)
+    {
+        err = ring_buffer_init(&sqi_mov_avg_ring_buf, sqi_mov_avg_buf, SQI_MOV_AVG_SIZE);
+    }
+    if (0 == err)
+    {
+        err = median_filter_init(&ibi_median_filt, ibi_median_data, ibi_median_pos,
+                                 ibi_median_heap, IBI_MEDIAN_SIZE);
+    }
+    if (0 == err)
+    {
+        err = hrv_init();
+    }
+    if (0 == err)
+    {
+        err = resp_init();
+    }
+    if (0 == err)
+    {
+        err = ppg_proc_reset();
+    }
+
+    return err;
+}
+
+// Brings every filter and accumulator back to its initial state, so a
+// restart does not mix the new signal with the one before the pause
+int ppg_proc_reset(void)
+{
+    int err;
+
+    err = ring_buffer_clear(&hr_mov_avg_ring_buf);
+    if (0 == err)
+    {
+        err = ring_buffer_clear(&ibi_mov_avg_ring_buf);
+    }
+    if (0 == err)
+    {
+        err = ring_buffer_clear(&amp_mov_avg_ring_buf);
+    }
+    if (0 == err)
+    {
+        err = ring_buffer_clear(&sqi_mov_avg_ring_buf);
+    }
+    if (0 == err)
+    {
+        err = median_filter_clear(&ibi_median_filt);
+    }
+    if (0 == err)
+    {
+        err = hrv_reset();
+    }
+    if (0 == err)
+    {
+        err = resp_reset();
+    }
+    if (0 == err)
+    {
+        err = spo2_init();
+    }
+    if (0 == err)
+    {
+        err = sqi_init();
+    }
+    if (0 == err)
+    {
+        err = timebase_clock_init(&ppg_clock, PPG_SAMPLE_PERIOD_MS * 1000U);
+    }
+
+    resetBeatDetector();
+
+    sample_cnt = 0;
+    have_last_beat = false;
+    last_beat_ts = 0;
+    beat_red_sum = 0;
+    beat_red_cnt = 0;
+    have_last_resp_beat = false;
+    last_resp_beat_ts = 0;
+
+    return err;
+}
+
+// Anchors the sample clock to the shared timebase, right after the sensor
+// FIFO was read
+void ppg_proc_sync_time(int64_t now_us)
+{
+    timebase_clock_sync(&ppg_clock, sample_cnt, now_us);
+}
+
+// Advances the sample clock over samples the sensor dropped, so the IBI
+// across the gap and the timestamps after it stay right
+void ppg_proc_skip_samples(uint32_t num_samples)
+{
+    sample_cnt += num_samples;
+}
+
+// Processes one sample. Returns true and fills in p_beat if a beat was
+// detected.
+bool ppg_proc_put_sample(int32_t red, int32_t ir, ppg_beat_t *p_beat)
+{
+    int64_t current_beat_ts;
+    int64_t beat_ts_us;
+    float diff_ms;
+    float resp_dt_ms;
+    float baseline;
+    float bpm;
+    float mean_bpm;
+    uint32_t sqi;
+    int32_t amplitude;
+    int16_t peak_offset;
+    bool beat_detected;
+    bool beat_valid;
+    bool ibi_in_range;
+    bool ibi_outlier;
+
+    // Beats are timed against the sensor sample clock rather than the
+    // time at which they are processed, so scheduling jitter does not
+    // leak into the IBIs
+    sample_cnt++;
+
+    spo2_put_sample(red, ir);
+
+    beat_red_sum += red;
+    beat_red_cnt++;
+
+    PROF_START(PROF_STAGE_CHECK_FOR_BEAT);
+    beat_detected = checkForBeat(red, &amplitude, &peak_offset);
+    PROF_STOP(PROF_STAGE_CHECK_FOR_BEAT);
+
+    sqi_put_sample(getACSignal());
+
+    if (!beat_detected)
+    {
+        return false;
+    }
+
+    beat_valid = false;
+    current_beat_ts = ((int64_t) sample_cnt << PPG_BEAT_TS_FRAC_BITS) + peak_offset;
+    beat_ts_us = timebase_clock_get_us(&ppg_clock,
+                                       current_beat_ts - ((int64_t) getBeatDetectorDelay() << PPG_BEAT_TS_FRAC_BITS),
+                                       PPG_BEAT_TS_FRAC_BITS);
+    diff_ms = 0.0f;
+    sqi = 0;
+
+    baseline = (float) beat_red_sum / beat_red_cnt;
+    beat_red_sum = 0;
+    beat_red_cnt = 0;
+
+    if (have_last_beat)
+    {
+        diff_ms = (float) (current_beat_ts - last_beat_ts) * PPG_SAMPLE_PERIOD_MS
+                  / (1 << PPG_BEAT_TS_FRAC_BITS);
+
+        bpm = ms_to_bpm(diff_ms);
+
+        ring_buffer_mov_avg(&hr_mov_avg_ring_buf, &mean_bpm);
+        sqi = sqi_check_beat(amplitude, diff_ms,
+                             (mean_bpm > 0.0f) ? (60000.0f / mean_bpm) : 0.0f);
+        ring_buffer_put(&sqi_mov_avg_ring_buf, (float) sqi);
+
+        // A single missed or extra beat still gives a realistic HR, but
+        // stands out against the median of the recent IBIs
+        ibi_in_range = (bpm > HR_MIN) && (bpm < HR_MAX);
+        ibi_outlier = ibi_in_range && is_ibi_outlier(diff_ms);
+        if (ibi_in_range)
+        {
+            median_filter_put(&ibi_median_filt, diff_ms);
+        }
+
+        // Check if HR is realistic and the pulse looks clean to reduce
+        // the effect of missed or false heart beats and motion
+        if (ibi_in_range && !ibi_outlier && (sqi >= SQI_MIN))
+        {
+            sqi_accept_beat();
+
+            ring_buffer_put(&hr_mov_avg_ring_buf, bpm);
+
+            ring_buffer_put(&ibi_mov_avg_ring_buf, diff_ms);
+
+            PROF_START(PROF_STAGE_HRV);
+            hrv_put_ibi(diff_ms);
+            PROF_STOP(PROF_STAGE_HRV);
+
+            ring_buffer_put(&amp_mov_avg_ring_buf, (float) amplitude);
+
+            resp_dt_ms = have_last_resp_beat ?
+                         (float) (current_beat_ts - last_resp_beat_ts) * PPG_SAMPLE_PERIOD_MS
+                         / (1 << PPG_BEAT_TS_FRAC_BITS) : 0.0f;
+
+            PROF_START(PROF_STAGE_RESP);
+            resp_put_beat(resp_dt_ms, (float) amplitude, baseline, diff_ms);
+            PROF_STOP(PROF_STAGE_RESP);
+
+            have_last_resp_beat = true;
+            last_resp_beat_ts = current_beat_ts;
+
+            beat_valid = true;
+
+            // printk("%d\n", (int) bpm);
+        }
+    }
+
+    spo2_end_beat(beat_valid);
+
+    last_beat_ts = current_beat_ts;
+    have_last_beat = true;
+
+    ppg_publish_metrics(beat_ts_us);
+
+    if (p_beat)
+    {
+        p_beat->ts_us = beat_ts_us;
+        p_beat->ibi_ms = diff_ms;
+        p_beat->sqi = sqi;
+        p_beat->valid = beat_valid;
+    }
+
+    return true;
+}
+
+uint32_t ppg_get_hr_bpm(void)
+{
+    float bpm;
+    ring_buffer_mov_avg(&hr_mov_avg_ring_buf, &bpm);
+    return (uint32_t) roundf(bpm);
+}
+
+uint32_t ppg_get_rmssd(void)
+{
+    rmssd_ctx_t ctx = {0};
+    int num_ibi;
+    float rmssd;
+
+    PROF_START(PROF_STAGE_RMSSD);
+
+    num_ibi = ring_buffer_visit(&ibi_mov_avg_ring_buf, rmssd_visit, &ctx);
+    if (num_ibi > 1)
+    {
+        rmssd = sqrtf(ctx.diff_sq_sum / (num_ibi - 1));
+    }
+    else
+    {
+        rmssd = 0.0f;
+    }
+
+    PROF_STOP(PROF_STAGE_RMSSD);
+
+    return (uint32_t) roundf(rmssd);
+}
+
+uint32_t ppg_get_amplitude(void)
+{
+    float ampl;
+    ring_buffer_mov_avg(&amp_mov_avg_ring_buf, &ampl);
+    return (uint32_t) roundf(ampl);
+}
+
+// Standard deviation of the most recent beat amplitudes
+uint32_t ppg_get_amplitude_sd(void)
+{
+    float var;
+    ring_buffer_var(&amp_mov_avg_ring_buf, &var);
+    return (uint32_t) roundf(sqrtf(var));
+}
+
+// Lowest and highest HR over the IBI window, 0 until the first valid beat
+uint32_t ppg_get_hr_min_bpm(void)
+{
+    float ibi_max;
+    ring_buffer_max(&ibi_mov_avg_ring_buf, &ibi_max);
+    return (ibi_max > 0.0f) ? (uint32_t) roundf(ms_to_bpm(ibi_max)) : 0;
+}
+
+uint32_t ppg_get_hr_max_bpm(void)
+{
+    float ibi_min;
+    ring_buffer_min(&ibi_mov_avg_ring_buf, &ibi_min);
+    return (ibi_min > 0.0f) ? (uint32_t) roundf(ms_to_bpm(ibi_min)) : 0;
+}
+
+// Mean signal quality index (0 - 100) of the most recent beats, including
+// the ones that were rejected
+uint32_t ppg_get_sqi(void)
+{
+    float sqi;
+    ring_buffer_mov_avg(&sqi_mov_avg_ring_buf, &sqi);
+    return (uint32_t) roundf(sqi);
+}
+
+// Publishes a consistent snapshot of everything derived from the beats,
+// once per detected beat
+static void ppg_publish_metrics(int64_t ts_us)
+{
+    metrics_ppg_t metrics;
+
+    metrics.ts_us = ts_us;
+
+    metrics.hr_bpm = (uint16_t) MIN(ppg_get_hr_bpm(), UINT16_MAX);
+    metrics.rmssd_ms = (uint16_t) MIN(ppg_get_rmssd(), UINT16_MAX);
+    metrics.amplitude = (uint16_t) MIN(ppg_get_amplitude(), UINT16_MAX);
+    metrics.amplitude_sd = (uint16_t) MIN(ppg_get_amplitude_sd(), UINT16_MAX);
+    metrics.hr_min_bpm = (uint16_t) MIN(ppg_get_hr_min_bpm(), UINT16_MAX);
+    metrics.hr_max_bpm = (uint16_t) MIN(ppg_get_hr_max_bpm(), UINT16_MAX);
+    metrics.lf_power = (uint16_t) MIN(hrv_get_lf_power(), UINT16_MAX);
+    metrics.hf_power = (uint16_t) MIN(hrv_get_hf_power(), UINT16_MAX);
+    metrics.lf_hf_ratio = (uint16_t) MIN(hrv_get_lf_hf_ratio(), UINT16_MAX);
+    metrics.spo2_pct = (uint8_t) spo2_get_percent();
+    metrics.sqi = (uint8_t) ppg_get_sqi();
+    metrics.resp_bpm = (uint8_t) MIN(resp_get_rate_bpm(), UINT8_MAX);
+    metrics.resp_quality = (uint8_t) resp_get_quality();
+    metrics.reserved = 0;
+
+    metrics_publish(METRICS_TOPIC_PPG, &metrics, sizeof(metrics));
+}
+
+// Accumulates squared successive IBI differences, carrying the last IBI
+// over from the previous span
+static void rmssd_visit(const float *p_ibi, size_t num_ibi, void *p_ctx)
+{
+    rmssd_ctx_t *p_rmssd = p_ctx;
+    float ibi_diff;
+
+    for (size_t i = 0; i < num_ibi; i++)
+    {
+        if (p_rmssd->have_prev)
+        {
+            ibi_diff = p_ibi[i] - p_rmssd->prev_ibi;
+            p_rmssd->diff_sq_sum += ibi_diff * ibi_diff;
+        }
+
+        p_rmssd->prev_ibi = p_ibi[i];
+        p_rmssd->have_prev = true;
+    }
+}
+
+static bool is_ibi_outlier(float ibi_ms)
+{
+    float median;
+
+    if (median_filter_get_num_items(&ibi_median_filt) < IBI_MEDIAN_MIN_ITEMS)
+    {
+        return false;
+    }
+
+    median_filter_get(&ibi_median_filt, &median);
+
+    return fabsf(ibi_ms - median) > (median * CONFIG_APP_IBI_OUTLIER_PCT / 100.0f);
+}
+
+static inline float ms_to_bpm(float ms)
+{
+    return 60.f / (ms / 1000.f);
+}
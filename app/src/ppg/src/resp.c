@@ -0,0 +1,263 @@
+/**
+ * Respiratory rate from the breathing modulation of the PPG beats.
+ *
+ * Breathing modulates three per-beat series: the pulse amplitude, the
+ * baseline (mean intensity over the beat) and the IBI (respiratory sinus
+ * arrhythmia). Each series is resampled onto a uniform grid like the HRV
+ * stage does and pushed into its own sliding DFT (sdft.c) that only tracks
+ * the bins of the breathing band. The spectral peak of each series gives one estimate, the
+ * reported rate is their mean. The estimates agreeing within RESP_MAX_SD_BPM
+ * marks the rate as good (smart fusion, Karlen et al. 2013).
+ *
+ * Cost is fixed at compile time:
+ * - memory: RESP_WIN_LEN history floats plus 4 floats per tracked bin for
+ *   each series (1.8 kB with the defaults below)
+ * - compute: RESP_NUM_MODS * RESP_NUM_BINS complex multiply-adds per
+ *   resampled point, i.e. about 110 per second, and a peak search over the
+ *   same bins once per beat
+*/
+
+#include "resp.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <math.h>
+
+#include "sdft.h"
+
+#define RESP_RESAMPLE_HZ 2
+#define RESP_RESAMPLE_PERIOD_MS (1000.0f / RESP_RESAMPLE_HZ)
+
+#define RESP_WIN_LEN 64 // 32 s window, 1.875 breaths/min bin spacing
+
+// Breathing band as DFT bin indexes, k = f * RESP_WIN_LEN / RESP_RESAMPLE_HZ
+#define RESP_FIRST_BIN 4  // 0.125 Hz, 7.5 breaths/min
+#define RESP_LAST_BIN 21  // 0.656 Hz, 39.4 breaths/min
+
+#define RESP_NUM_BINS (RESP_LAST_BIN - RESP_FIRST_BIN + 1)
+
+// Longer gaps between beats restart the window, interpolating over them
+// would make up a modulation
+#define RESP_MAX_GAP_MS 4000.0f
+
+// Largest standard deviation of the three estimates for a good rate
+#define RESP_MAX_SD_BPM 4.0f
+
+// Running mean removed from every series before it enters its DFT
+#define MEAN_ALPHA 0.05f
+
+LOG_MODULE_REGISTER(resp, CONFIG_APP_LOG_LEVEL);
+
+typedef enum resp_mod
+{
+    RESP_MOD_AMPLITUDE,
+    RESP_MOD_BASELINE,
+    RESP_MOD_IBI,
+    RESP_NUM_MODS,
+} resp_mod_t;
+
+typedef struct resp_series
+{
+    float hist[RESP_WIN_LEN];
+    float bins[SDFT_BINS_LEN(RESP_NUM_BINS)];
+    sdft_t sdft;
+    float mean;
+    float last;  // Value at the previous beat
+} resp_series_t;
+
+static void series_push(resp_series_t *p_series, float x);
+static float peak_bpm(const resp_series_t *p_series);
+
+static resp_series_t series[RESP_NUM_MODS];
+
+static bool have_last_beat;
+static float grid_pos_ms;
+
+static float rate_bpm;
+static resp_quality_t quality;
+
+static struct k_mutex resp_mutex;
+
+int resp_init(void)
+{
+    int err;
+
+    for (size_t m = 0; m < RESP_NUM_MODS; m++)
+    {
+        err = sdft_init(&series[m].sdft, series[m].hist, RESP_WIN_LEN, series[m].bins,
+                        RESP_FIRST_BIN, RESP_NUM_BINS);
+        if (err < 0)
+        {
+            return err;
+        }
+    }
+
+    k_mutex_init(&resp_mutex);
+
+    LOG_DBG("Respiration stage uses %u bytes, %u bins at %u Hz",
+            (unsigned int) sizeof(series), RESP_NUM_BINS, RESP_RESAMPLE_HZ);
+
+    return resp_reset();
+}
+
+// Takes the modulations of one accepted beat. dt_ms is the time since the
+// previous accepted beat, 0 for the first one.
+int resp_put_beat(float dt_ms, float amplitude, float baseline, float ibi_ms)
+{
+    const float values[RESP_NUM_MODS] = {
+        [RESP_MOD_AMPLITUDE] = amplitude,
+        [RESP_MOD_BASELINE] = baseline,
+        [RESP_MOD_IBI] = ibi_ms,
+    };
+    float estimates[RESP_NUM_MODS];
+    float mean = 0.0f;
+    float var = 0.0f;
+    float frac;
+
+    if (ibi_ms <= 0.0f)
+    {
+        return -1;
+    }
+
+    if (have_last_beat && ((dt_ms <= 0.0f) || (dt_ms > RESP_MAX_GAP_MS)))
+    {
+        resp_reset();
+    }
+
+    if (!have_last_beat)
+    {
+        for (size_t m = 0; m < RESP_NUM_MODS; m++)
+        {
+            series[m].last = values[m];
+            series[m].mean = values[m];
+        }
+        have_last_beat = true;
+        return 0;
+    }
+
+    // The previous beat sits at time 0 and this one at dt_ms. Emit every
+    // grid point in between, interpolated between the two beats.
+    while (grid_pos_ms <= dt_ms)
+    {
+        frac = grid_pos_ms / dt_ms;
+        for (size_t m = 0; m < RESP_NUM_MODS; m++)
+        {
+            series_push(&series[m], series[m].last + (values[m] - series[m].last) * frac);
+        }
+
+        grid_pos_ms += RESP_RESAMPLE_PERIOD_MS;
+    }
+
+    grid_pos_ms -= dt_ms;
+    for (size_t m = 0; m < RESP_NUM_MODS; m++)
+    {
+        series[m].last = values[m];
+    }
+
+    // All series are pushed together, so they fill up together
+    if (!sdft_is_full(&series[0].sdft))
+    {
+        return 0;
+    }
+
+    for (size_t m = 0; m < RESP_NUM_MODS; m++)
+    {
+        estimates[m] = peak_bpm(&series[m]);
+        mean += estimates[m];
+    }
+    mean /= RESP_NUM_MODS;
+
+    for (size_t m = 0; m < RESP_NUM_MODS; m++)
+    {
+        var += (estimates[m] - mean) * (estimates[m] - mean);
+    }
+    var /= RESP_NUM_MODS;
+
+    k_mutex_lock(&resp_mutex, K_FOREVER);
+    rate_bpm = mean;
+    quality = (var <= RESP_MAX_SD_BPM * RESP_MAX_SD_BPM) ? RESP_QUALITY_GOOD : RESP_QUALITY_LOW;
+    k_mutex_unlock(&resp_mutex);
+
+    return 0;
+}
+
+// Breaths per minute, 0 until the window is filled
+uint32_t resp_get_rate_bpm(void)
+{
+    float bpm;
+
+    k_mutex_lock(&resp_mutex, K_FOREVER);
+    bpm = rate_bpm;
+    k_mutex_unlock(&resp_mutex);
+
+    return (uint32_t) roundf(bpm);
+}
+
+resp_quality_t resp_get_quality(void)
+{
+    resp_quality_t q;
+
+    k_mutex_lock(&resp_mutex, K_FOREVER);
+    q = quality;
+    k_mutex_unlock(&resp_mutex);
+
+    return q;
+}
+
+// Empties the window, the estimate is withdrawn until it is filled again
+int resp_reset(void)
+{
+    for (size_t m = 0; m < RESP_NUM_MODS; m++)
+    {
+        sdft_clear(&series[m].sdft);
+        series[m].mean = 0.0f;
+        series[m].last = 0.0f;
+    }
+
+    have_last_beat = false;
+    grid_pos_ms = 0.0f;
+
+    k_mutex_lock(&resp_mutex, K_FOREVER);
+    rate_bpm = 0.0f;
+    quality = RESP_QUALITY_NONE;
+    k_mutex_unlock(&resp_mutex);
+
+    return 0;
+}
+
+// Removes the running mean of the series before the point enters its DFT
+static void series_push(resp_series_t *p_series, float x)
+{
+    p_series->mean += MEAN_ALPHA * (x - p_series->mean);
+    sdft_push(&p_series->sdft, x - p_series->mean);
+}
+
+// Frequency of the strongest bin in breaths per minute, refined by a
+// parabola through its neighbours
+static float peak_bpm(const resp_series_t *p_series)
+{
+    float power[RESP_NUM_BINS];
+    size_t peak = 0;
+    float offset = 0.0f;
+    float den;
+
+    for (size_t i = 0; i < RESP_NUM_BINS; i++)
+    {
+        power[i] = sdft_power(&p_series->sdft, RESP_FIRST_BIN + i);
+        if (power[i] > power[peak])
+        {
+            peak = i;
+        }
+    }
+
+    if ((peak > 0) && (peak < RESP_NUM_BINS - 1))
+    {
+        den = power[peak - 1] - 2.0f * power[peak] + power[peak + 1];
+        if (den < 0.0f)
+        {
+            offset = 0.5f * (power[peak - 1] - power[peak + 1]) / den;
+        }
+    }
+
+    return 60.0f * (RESP_FIRST_BIN + peak + offset) * RESP_RESAMPLE_HZ / RESP_WIN_LEN;
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+/**
+ * Streaming SpO2 estimation from the red and IR channels.
+ *
+ * Every sample updates the running min, max and sum of both channels in
+ * integer arithmetic. When the beat detector closes a beat, AC (max - min)
+ * and DC (mean) over that beat give the ratio of ratios
+ * R = (AC_red / DC_red) / (AC_ir / DC_ir), which is mapped to SpO2 through a
+ * calibration table. The windows are the beat boundaries found by
+ * checkForBeat(), no second detector is run.
+*/
+
+#include "spo2.h"
+
+#include <zephyr/kernel.h>
+#include <math.h>
+
+#include "ring_buffer.h"
+
+#define SPO2_MOV_AVG_SIZE 4
+
+// Longer than the slowest accepted beat at 50 Hz. Keeps the sums in range
+// when no beats are found for a while.
+#define MAX_BEAT_SAMPLES 128
+
+// Ratio of ratios is kept with 8 fractional bits
+#define RATIO_FRAC_BITS 8
+
+// Calibration table spacing, R = 0.125 per entry
+#define CAL_STEP_SHIFT 5
+#define CAL_TABLE_SIZE 17
+
+typedef struct beat_stats
+{
+    int32_t min;
+    int32_t max;
+    int32_t sum;
+} beat_stats_t;
+
+static void beat_stats_reset(beat_stats_t *p_stats);
+static void beat_stats_put(beat_stats_t *p_stats, int32_t sample);
+static uint32_t ratio_to_spo2(uint32_t ratio);
+
+// SpO2 in 0.1 % for R = 0, 0.125, ... 2.0. Derived from the Maxim reference
+// curve SpO2 = -45.060 R^2 + 30.354 R + 94.845, clamped to 100 % below
+// R = 0.4 where the curve is no longer monotonic.
+static const uint16_t cal_table[CAL_TABLE_SIZE] = {
+    1000, 1000, 1000, 999, 988, 962, 923, 869, 801,
+    720, 624, 514, 390, 252, 100, 0, 0,
+};
+
+static beat_stats_t red_stats;
+static beat_stats_t ir_stats;
+static int32_t beat_num_samples;
+static bool beat_overflow;
+
+static float spo2_mov_avg_buf[SPO2_MOV_AVG_SIZE];
+static ring_buffer_t spo2_mov_avg_ring_buf;
+
+int spo2_init(void)
+{
+    beat_stats_reset(&red_stats);
+    beat_stats_reset(&ir_stats);
+    beat_num_samples = 0;
+    beat_overflow = false;
+
+    return ring_buffer_init(&spo2_mov_avg_ring_buf, spo2_mov_avg_buf, SPO2_MOV_AVG_SIZE);
+}
+
+void spo2_put_sample(int32_t red, int32_t ir)
+{
+    if (beat_num_samples >= MAX_BEAT_SAMPLES)
+    {
+        beat_stats_reset(&red_stats);
+        beat_stats_reset(&ir_stats);
+        beat_num_samples = 0;
+        beat_overflow = true;
+    }
+
+    beat_stats_put(&red_stats, red);
+    beat_stats_put(&ir_stats, ir);
+    beat_num_samples++;
+}
+
+// Close the current beat window. Beats rejected by the detector still reset
+// the window, but do not contribute to the estimate.
+void spo2_end_beat(bool valid)
+{
+    int64_t num;
+    int64_t den;
+    uint32_t ratio;
+
+    if (valid && !beat_overflow && (beat_num_samples > 0))
+    {
+        // (AC_red / DC_red) / (AC_ir / DC_ir) with DC = sum / n, n cancels
+        num = (int64_t) (red_stats.max - red_stats.min) * ir_stats.sum;
+        den = (int64_t) (ir_stats.max - ir_stats.min) * red_stats.sum;
+
+        if ((num > 0) && (den > 0))
+        {
+            ratio = (uint32_t) ((num << RATIO_FRAC_BITS) / den);
+
+            ring_buffer_put(&spo2_mov_avg_ring_buf,
+                            (float) ratio_to_spo2(ratio) / 10.0f);
+        }
+    }
+
+    beat_stats_reset(&red_stats);
+    beat_stats_reset(&ir_stats);
+    beat_num_samples = 0;
+    beat_overflow = false;
+}
+
+uint32_t spo2_get_percent(void)
+{
+    float spo2;
+    ring_buffer_mov_avg(&spo2_mov_avg_ring_buf, &spo2);
+    return (uint32_t) roundf(spo2);
+}
+
+static void beat_stats_reset(beat_stats_t *p_stats)
+{
+    p_stats->min = INT32_MAX;
+    p_stats->max = INT32_MIN;
+    p_stats->sum = 0;
+}
+
+static void beat_stats_put(beat_stats_t *p_stats, int32_t sample)
+{
+    if (sample < p_stats->min)
+    {
+        p_stats->min = sample;
+    }
+    if (sample > p_stats->max)
+    {
+        p_stats->max = sample;
+    }
+    p_stats->sum += sample;
+}
+
+// Linear interpolation in the calibration table, returns SpO2 in 0.1 %
+static uint32_t ratio_to_spo2(uint32_t ratio)
+{
+    uint32_t idx = ratio >> CAL_STEP_SHIFT;
+    uint32_t frac = ratio & ((1U << CAL_STEP_SHIFT) - 1);
+    int32_t lo;
+    int32_t hi;
+
+    if (idx >= CAL_TABLE_SIZE - 1)
+    {
+        return cal_table[CAL_TABLE_SIZE - 1];
+    }
+
+    lo = cal_table[idx];
+    hi = cal_table[idx + 1];
+
+    return (uint32_t) (lo + (((hi - lo) * (int32_t) frac) >> CAL_STEP_SHIFT));
+}
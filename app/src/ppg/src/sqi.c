@@ -0,0 +1,199 @@
+/**
+ * Per-beat signal quality index (SQI) used to gate motion artifacts.
+ *
+ * Three scores in the range 0 - 100 are computed for every detected beat:
+ * - amplitude consistency against the running mean of accepted amplitudes
+ * - squared correlation of the pulse shape against a running average
+ *   template of accepted pulses
+ * - IBI plausibility against the expected IBI from the current heart rate
+ * The SQI is the smallest of the three, so a beat has to pass all of them.
+ * Until enough beats have been accepted to build the references, beats are
+ * only checked by the caller's heart rate range.
+ *
+ * Everything runs in integer arithmetic over a SQI_SEG_LEN sample segment,
+ * which is a few dozen multiply-adds and a single 64-bit division per beat.
+*/
+
+#include "sqi.h"
+
+#include <zephyr/kernel.h>
+#include <stdlib.h>
+
+// 320 ms of the band-passed pulse at 50 Hz, ending just after the peak
+#define SQI_SEG_LEN 16
+
+// Segments are scaled so the beat amplitude spans 2^SEG_SCALE_BITS, and
+// clipped to SEG_CLIP times that to keep the correlation sums in range
+#define SEG_SCALE_BITS 8
+#define SEG_CLIP (4 << SEG_SCALE_BITS)
+
+// Fractional bits of the reciprocal of the amplitude, enough for the 18-bit
+// samples of the MAX30101/MAX30102
+#define RECIP_BITS 30
+
+// Accepted beats needed before the template is trusted
+#define TEMPLATE_WARMUP_BEATS 4
+
+// Consecutive rejected beats after which the references are relearned, so a
+// bad template or a step change in heart rate cannot lock out every beat
+#define RELEARN_BEATS 8
+
+// Template and amplitude reference adapt with weight 1/2^ADAPT_SHIFT
+#define ADAPT_SHIFT 3
+
+// An IBI this far (in %) from the expected one scores 0
+#define IBI_MAX_DEV_PCT 50
+
+#define SCORE_MAX 100
+
+static uint32_t relative_dev_score(int32_t value, int32_t ref, int32_t max_dev_pct);
+static uint32_t template_score(void);
+
+static int32_t ac_buf[SQI_SEG_LEN];
+static size_t ac_buf_idx;
+
+static int32_t seg[SQI_SEG_LEN];
+static int32_t template[SQI_SEG_LEN];
+static int64_t template_energy;
+static uint32_t num_accepted;
+static uint32_t num_rejected;
+
+static int32_t amp_ref;
+static int32_t last_amplitude;
+
+int sqi_init(void)
+{
+    memset(ac_buf, 0, sizeof(ac_buf));
+    ac_buf_idx = 0;
+    memset(template, 0, sizeof(template));
+    template_energy = 0;
+    num_accepted = 0;
+    num_rejected = 0;
+    amp_ref = 0;
+
+    return 0;
+}
+
+void sqi_put_sample(int32_t ac_sample)
+{
+    ac_buf[ac_buf_idx] = ac_sample;
+    ac_buf_idx = (ac_buf_idx + 1) % SQI_SEG_LEN;
+}
+
+// Returns the SQI of the beat that was just detected. The beat is only
+// folded into the references if sqi_accept_beat() is called afterwards.
+uint32_t sqi_check_beat(int32_t amplitude, float ibi_ms, float expected_ibi_ms)
+{
+    int64_t scale;
+    uint32_t sqi = SCORE_MAX;
+    uint32_t score;
+
+    // Normalise the segment to the beat amplitude, oldest sample first
+    scale = (amplitude > 0) ? ((1LL << RECIP_BITS) / amplitude) : 0;
+    for (size_t i = 0; i < SQI_SEG_LEN; i++)
+    {
+        int64_t value = (ac_buf[(ac_buf_idx + i) % SQI_SEG_LEN] * scale) >>
+                        (RECIP_BITS - SEG_SCALE_BITS);
+        seg[i] = (int32_t) CLAMP(value, -SEG_CLIP, SEG_CLIP);
+    }
+
+    last_amplitude = amplitude;
+
+    if (num_rejected >= RELEARN_BEATS)
+    {
+        num_accepted = 0;
+        num_rejected = 0;
+    }
+
+    if (num_accepted >= TEMPLATE_WARMUP_BEATS)
+    {
+        score = relative_dev_score(amplitude, amp_ref, 100);
+        sqi = MIN(sqi, score);
+
+        score = template_score();
+        sqi = MIN(sqi, score);
+
+        if (expected_ibi_ms > 0.0f)
+        {
+            score = relative_dev_score((int32_t) ibi_ms, (int32_t) expected_ibi_ms,
+                                       IBI_MAX_DEV_PCT);
+            sqi = MIN(sqi, score);
+        }
+    }
+
+    // Cleared again if the caller accepts the beat
+    num_rejected++;
+
+    return sqi;
+}
+
+void sqi_accept_beat(void)
+{
+    int64_t energy = 0;
+
+    if (0 == num_accepted)
+    {
+        memcpy(template, seg, sizeof(template));
+        amp_ref = last_amplitude;
+    }
+    else
+    {
+        for (size_t i = 0; i < SQI_SEG_LEN; i++)
+        {
+            template[i] += (seg[i] - template[i]) >> ADAPT_SHIFT;
+        }
+        amp_ref += (last_amplitude - amp_ref) >> ADAPT_SHIFT;
+    }
+
+    for (size_t i = 0; i < SQI_SEG_LEN; i++)
+    {
+        energy += (int64_t) template[i] * template[i];
+    }
+    template_energy = energy;
+
+    if (num_accepted < TEMPLATE_WARMUP_BEATS)
+    {
+        num_accepted++;
+    }
+    num_rejected = 0;
+}
+
+// 100 at value == ref, falling linearly to 0 at max_dev_pct % deviation
+static uint32_t relative_dev_score(int32_t value, int32_t ref, int32_t max_dev_pct)
+{
+    int32_t dev_pct;
+
+    if (ref <= 0)
+    {
+        return SCORE_MAX;
+    }
+
+    dev_pct = (100 * abs(value - ref)) / ref;
+    if (dev_pct >= max_dev_pct)
+    {
+        return 0;
+    }
+
+    return SCORE_MAX - (SCORE_MAX * dev_pct) / max_dev_pct;
+}
+
+// Squared correlation coefficient of the segment against the template,
+// negative correlation scores 0
+static uint32_t template_score(void)
+{
+    int64_t dot = 0;
+    int64_t seg_energy = 0;
+
+    for (size_t i = 0; i < SQI_SEG_LEN; i++)
+    {
+        dot += (int64_t) seg[i] * template[i];
+        seg_energy += (int64_t) seg[i] * seg[i];
+    }
+
+    if ((dot <= 0) || (0 == seg_energy) || (0 == template_energy))
+    {
+        return 0;
+    }
+
+    return (uint32_t) ((SCORE_MAX * dot * dot) / (seg_energy * template_energy));
+}
@@ -0,0 +1,28 @@
+#ifndef _REPORT_H_
+#define _REPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Longest payload that fits a notification with the default ATT MTU
+#define REPORT_MSG_MAX_LEN 20
+
+// One little endian field of the payload
+typedef struct report_field
+{
+    uint8_t offset;
+    uint8_t size;         // 1 or 2 bytes
+    uint16_t deadband;    // Smaller changes are not worth a message
+    uint16_t escalate;    // Larger changes switch to sending every period
+} report_field_t;
+
+int report_init(const report_field_t *p_fields, size_t num_fields, size_t msg_len);
+
+void report_reset(void);
+
+bool report_should_send(const uint8_t *p_msg);
+
+void report_get_counters(uint32_t *p_sent, uint32_t *p_suppressed);
+
+#endif /* _REPORT_H_ */
\ No newline at end of file
@@ -0,0 +1,179 @@
+/**
+ * Reporting policy that decides whether a payload is worth sending.
+ *
+ * Every field has a deadband and a message is only sent when at least one
+ * field moved by its deadband or more since the last sent message, or when
+ * nothing was sent for CONFIG_APP_REPORT_MAX_SILENCE_S. A field that moves
+ * by its escalation threshold or more switches to sending every period for
+ * CONFIG_APP_REPORT_ESCALATION_S, so rapid changes are followed closely.
+*/
+
+#include "report.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/shell/shell.h>
+
+#define REPORT_MAX_SILENCE_MS (CONFIG_APP_REPORT_MAX_SILENCE_S * 1000LL)
+#define REPORT_ESCALATION_MS (CONFIG_APP_REPORT_ESCALATION_S * 1000LL)
+
+static const report_field_t *p_report_fields;
+static size_t report_num_fields;
+static size_t report_msg_len;
+
+static uint8_t last_msg[REPORT_MSG_MAX_LEN];
+static bool have_last_msg;
+static int64_t last_sent_ms;
+static int64_t escalated_until_ms;
+
+static atomic_t num_sent;
+static atomic_t num_suppressed;
+
+static K_MUTEX_DEFINE(report_mutex);
+
+static inline uint16_t field_get(const report_field_t *p_field, const uint8_t *p_msg);
+
+int report_init(const report_field_t *p_fields, size_t num_fields, size_t msg_len)
+{
+    if (!p_fields || (msg_len > REPORT_MSG_MAX_LEN))
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < num_fields; i++)
+    {
+        if ((p_fields[i].offset + p_fields[i].size > msg_len) ||
+            (p_fields[i].size < 1) || (p_fields[i].size > 2))
+        {
+            return -1;
+        }
+    }
+
+    k_mutex_lock(&report_mutex, K_FOREVER);
+
+    p_report_fields = p_fields;
+    report_num_fields = num_fields;
+    report_msg_len = msg_len;
+    have_last_msg = false;
+    escalated_until_ms = 0;
+
+    k_mutex_unlock(&report_mutex);
+
+    atomic_clear(&num_sent);
+    atomic_clear(&num_suppressed);
+
+    return 0;
+}
+
+// Forgets the last sent message, so the next one is always sent. Used when
+// a new central connects.
+void report_reset(void)
+{
+    k_mutex_lock(&report_mutex, K_FOREVER);
+
+    have_last_msg = false;
+    escalated_until_ms = 0;
+
+    k_mutex_unlock(&report_mutex);
+}
+
+// Returns true if the message should be sent, in which case it becomes the
+// reference for the following ones
+bool report_should_send(const uint8_t *p_msg)
+{
+    int64_t now_ms = k_uptime_get();
+    bool send;
+    bool changed = false;
+    int32_t diff;
+
+    if (!p_msg || !p_report_fields)
+    {
+        return false;
+    }
+
+    k_mutex_lock(&report_mutex, K_FOREVER);
+
+    if (!have_last_msg)
+    {
+        send = true;
+    }
+    else
+    {
+        for (size_t i = 0; i < report_num_fields; i++)
+        {
+            diff = abs((int32_t) field_get(&p_report_fields[i], p_msg) -
+                       (int32_t) field_get(&p_report_fields[i], last_msg));
+
+            if (diff >= p_report_fields[i].deadband)
+            {
+                changed = true;
+            }
+
+            if (diff >= p_report_fields[i].escalate)
+            {
+                escalated_until_ms = now_ms + REPORT_ESCALATION_MS;
+            }
+        }
+
+        send = changed ||
+               (now_ms < escalated_until_ms) ||
+               (now_ms - last_sent_ms >= REPORT_MAX_SILENCE_MS);
+    }
+
+    if (send)
+    {
+        memcpy(last_msg, p_msg, report_msg_len);
+        have_last_msg = true;
+        last_sent_ms = now_ms;
+    }
+
+    k_mutex_unlock(&report_mutex);
+
+    atomic_inc(send ? &num_sent : &num_suppressed);
+
+    return send;
+}
+
+void report_get_counters(uint32_t *p_sent, uint32_t *p_suppressed)
+{
+    if (p_sent)
+    {
+        *p_sent = (uint32_t) atomic_get(&num_sent);
+    }
+
+    if (p_suppressed)
+    {
+        *p_suppressed = (uint32_t) atomic_get(&num_suppressed);
+    }
+}
+
+static inline uint16_t field_get(const report_field_t *p_field, const uint8_t *p_msg)
+{
+    if (2 == p_field->size)
+    {
+        return sys_get_le16(&p_msg[p_field->offset]);
+    }
+
+    return p_msg[p_field->offset];
+}
+
+#if defined(CONFIG_SHELL)
+
+static int cmd_report(const struct shell *sh, size_t argc, char **argv)
+{
+    uint32_t sent;
+    uint32_t suppressed;
+
+    report_get_counters(&sent, &suppressed);
+
+    shell_print(sh, "%u messages sent, %u suppressed", sent, suppressed);
+
+    return 0;
+}
+
+SHELL_CMD_REGISTER(report, NULL, "Sent and suppressed message counters", cmd_report);
+
+#endif /* CONFIG_SHELL */
\ No newline at end of file
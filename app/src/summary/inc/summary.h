@@ -0,0 +1,35 @@
+#ifndef _SUMMARY_H_
+#define _SUMMARY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// HR zones: below the first boundary, then one zone per boundary
+#define SUMMARY_NUM_HR_ZONES 6
+
+// Serialized sizes, see summary_serialize()
+#define SUMMARY_HEADER_LEN (4 + 1 + (SUMMARY_NUM_HR_ZONES - 1) + SUMMARY_NUM_HR_ZONES * sizeof(uint32_t) + 1)
+#define SUMMARY_RECORD_LEN (4 + 4 + 2 + 1 + SUMMARY_NUM_HR_ZONES)
+
+typedef struct summary_record
+{
+    uint32_t minute;        // Minutes since boot
+    uint8_t hr_min_bpm;     // HR fields are 0 without valid beats
+    uint8_t hr_mean_bpm;
+    uint8_t hr_max_bpm;
+    uint8_t num_beats;
+    uint16_t tonic_ns;      // Mean EDA tonic level, 0 without EDA
+    uint8_t num_scr;
+    uint8_t zone_s[SUMMARY_NUM_HR_ZONES]; // Seconds spent in each HR zone
+} summary_record_t;
+
+int summary_init(void);
+
+void summary_put_beat(int64_t ts_us, float ibi_ms);
+
+void summary_put_eda(int64_t ts_us, uint32_t tonic_ns, uint32_t num_scr);
+
+size_t summary_serialize(int64_t now_us, uint32_t first_minute, uint8_t *p_buf, size_t size);
+
+#endif /* _SUMMARY_H_ */
\ No newline at end of file
@@ -0,0 +1,330 @@
+/**
+ * Per-minute summaries and HR zone histograms, so a central does not have to
+ * stay connected to follow the long-term trends.
+ *
+ * The sampling threads feed every valid beat and every EDA wakeup with its
+ * time on the shared timebase. The values of the current minute are
+ * accumulated and turned into a summary_record_t once a later minute starts
+ * or the summaries are read. The last CONFIG_APP_SUMMARY_MINUTES records
+ * are kept in a ring, older ones are overwritten. Minutes without sampling have no record.
+ *
+ * Time in the HR zones is the sum of the IBIs of the beats whose HR falls
+ * into each zone. Besides the seconds in every record, the totals since boot
+ * are kept, and survive records that were overwritten.
+*/
+
+#include "summary.h"
+
+#include <string.h>
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/shell/shell.h>
+
+#include "timebase.h"
+
+#define US_PER_MINUTE 60000000LL
+
+#define SUMMARY_NUM_RECORDS CONFIG_APP_SUMMARY_MINUTES
+
+BUILD_ASSERT((CONFIG_APP_SUMMARY_HR_ZONE_1_BPM < CONFIG_APP_SUMMARY_HR_ZONE_2_BPM) &&
+             (CONFIG_APP_SUMMARY_HR_ZONE_2_BPM < CONFIG_APP_SUMMARY_HR_ZONE_3_BPM) &&
+             (CONFIG_APP_SUMMARY_HR_ZONE_3_BPM < CONFIG_APP_SUMMARY_HR_ZONE_4_BPM) &&
+             (CONFIG_APP_SUMMARY_HR_ZONE_4_BPM < CONFIG_APP_SUMMARY_HR_ZONE_5_BPM),
+             "HR zone boundaries have to be ascending");
+
+// Accumulated values of the current minute
+typedef struct summary_acc
+{
+    uint32_t minute;
+    bool active;            // Something was fed during the minute
+    float ibi_sum_ms;
+    float ibi_min_ms;
+    float ibi_max_ms;
+    uint32_t num_beats;
+    float zone_ms[SUMMARY_NUM_HR_ZONES];
+    uint64_t tonic_sum_ns;
+    uint32_t num_tonic;
+    uint32_t num_scr;
+} summary_acc_t;
+
+static void summary_advance(int64_t ts_us);
+static void summary_close(void);
+static size_t hr_zone(float bpm);
+
+// Lowest HR of zones 1 to 5, below the first one is zone 0
+static const uint8_t hr_zone_bpm[SUMMARY_NUM_HR_ZONES - 1] = {
+    CONFIG_APP_SUMMARY_HR_ZONE_1_BPM,
+    CONFIG_APP_SUMMARY_HR_ZONE_2_BPM,
+    CONFIG_APP_SUMMARY_HR_ZONE_3_BPM,
+    CONFIG_APP_SUMMARY_HR_ZONE_4_BPM,
+    CONFIG_APP_SUMMARY_HR_ZONE_5_BPM,
+};
+
+static summary_acc_t acc;
+
+static summary_record_t records[SUMMARY_NUM_RECORDS];
+static size_t record_head;  // Where the next record goes
+static size_t num_records;
+
+static uint64_t zone_total_ms[SUMMARY_NUM_HR_ZONES];
+
+static K_MUTEX_DEFINE(summary_mutex);
+
+int summary_init(void)
+{
+    k_mutex_lock(&summary_mutex, K_FOREVER);
+
+    memset(&acc, 0, sizeof(acc));
+    record_head = 0;
+    num_records = 0;
+    memset(zone_total_ms, 0, sizeof(zone_total_ms));
+
+    k_mutex_unlock(&summary_mutex);
+
+    return 0;
+}
+
+// Adds a valid beat, with the IBI that ended at ts_us
+void summary_put_beat(int64_t ts_us, float ibi_ms)
+{
+    if (ibi_ms <= 0.0f)
+    {
+        return;
+    }
+
+    k_mutex_lock(&summary_mutex, K_FOREVER);
+
+    summary_advance(ts_us);
+
+    if ((0 == acc.num_beats) || (ibi_ms < acc.ibi_min_ms))
+    {
+        acc.ibi_min_ms = ibi_ms;
+    }
+    if ((0 == acc.num_beats) || (ibi_ms > acc.ibi_max_ms))
+    {
+        acc.ibi_max_ms = ibi_ms;
+    }
+
+    acc.ibi_sum_ms += ibi_ms;
+    acc.num_beats++;
+    acc.zone_ms[hr_zone(60000.0f / ibi_ms)] += ibi_ms;
+
+    k_mutex_unlock(&summary_mutex);
+}
+
+// Adds the EDA tonic level at ts_us and the SCRs detected since the last
+// call. A tonic level of 0 means the EDA filters are still settling.
+void summary_put_eda(int64_t ts_us, uint32_t tonic_ns, uint32_t num_scr)
+{
+    k_mutex_lock(&summary_mutex, K_FOREVER);
+
+    summary_advance(ts_us);
+
+    if (tonic_ns > 0)
+    {
+        acc.tonic_sum_ns += tonic_ns;
+        acc.num_tonic++;
+    }
+
+    acc.num_scr += num_scr;
+
+    k_mutex_unlock(&summary_mutex);
+}
+
+/**
+ * Serializes the HR zones and the records of the minutes from first_minute
+ * on, oldest first, as many as fit. All values are little endian:
+ * [0..3] current minute since boot, to place the records in time
+ * [4] number of HR zones N
+ * [5..] lowest HR of zones 1 to N - 1 in bpm, one byte each
+ * [..] N uint32 seconds spent in each zone since boot
+ * [..] number of records R
+ * [..] R records of SUMMARY_RECORD_LEN bytes: uint32 minute, uint8 HR
+ *      min, mean and max, uint8 number of beats, uint16 mean tonic level in
+ *      nS, uint8 number of SCRs, N uint8 seconds spent in each zone
+ *
+ * The minute in progress is not included, it is closed once now_us is past
+ * it. Returns the serialized length.
+*/
+size_t summary_serialize(int64_t now_us, uint32_t first_minute, uint8_t *p_buf, size_t size)
+{
+    const summary_record_t *p_rec;
+    size_t len = 0;
+    size_t num_len;
+    uint8_t num = 0;
+
+    if (!p_buf || (size < SUMMARY_HEADER_LEN))
+    {
+        return 0;
+    }
+
+    k_mutex_lock(&summary_mutex, K_FOREVER);
+
+    if (acc.active && (now_us / US_PER_MINUTE > acc.minute))
+    {
+        summary_close();
+    }
+
+    sys_put_le32((uint32_t) (now_us / US_PER_MINUTE), &p_buf[len]);
+    len += sizeof(uint32_t);
+
+    p_buf[len++] = SUMMARY_NUM_HR_ZONES;
+
+    memcpy(&p_buf[len], hr_zone_bpm, sizeof(hr_zone_bpm));
+    len += sizeof(hr_zone_bpm);
+
+    for (size_t i = 0; i < SUMMARY_NUM_HR_ZONES; i++)
+    {
+        sys_put_le32((uint32_t) (zone_total_ms[i] / 1000U), &p_buf[len]);
+        len += sizeof(uint32_t);
+    }
+
+    num_len = len++;
+
+    for (size_t i = 0; i < num_records; i++)
+    {
+        p_rec = &records[(record_head + SUMMARY_NUM_RECORDS - num_records + i) % SUMMARY_NUM_RECORDS];
+
+        if (p_rec->minute < first_minute)
+        {
+            continue;
+        }
+
+        if ((len + SUMMARY_RECORD_LEN > size) || (UINT8_MAX == num))
+        {
+            break;
+        }
+
+        sys_put_le32(p_rec->minute, &p_buf[len]);
+        p_buf[len + 4] = p_rec->hr_min_bpm;
+        p_buf[len + 5] = p_rec->hr_mean_bpm;
+        p_buf[len + 6] = p_rec->hr_max_bpm;
+        p_buf[len + 7] = p_rec->num_beats;
+        sys_put_le16(p_rec->tonic_ns, &p_buf[len + 8]);
+        p_buf[len + 10] = p_rec->num_scr;
+        memcpy(&p_buf[len + 11], p_rec->zone_s, SUMMARY_NUM_HR_ZONES);
+        len += SUMMARY_RECORD_LEN;
+
+        num++;
+    }
+
+    k_mutex_unlock(&summary_mutex);
+
+    p_buf[num_len] = num;
+
+    return len;
+}
+
+// Closes the current minute if ts_us is in a later one. Samples that come in
+// a little late from the other thread still count towards the current one.
+static void summary_advance(int64_t ts_us)
+{
+    uint32_t minute = (uint32_t) (ts_us / US_PER_MINUTE);
+
+    if (acc.active && (minute <= acc.minute))
+    {
+        return;
+    }
+
+    if (acc.active)
+    {
+        summary_close();
+    }
+
+    acc.minute = minute;
+    acc.active = true;
+}
+
+// Turns the accumulated values into a record and starts over
+static void summary_close(void)
+{
+    summary_record_t *p_rec = &records[record_head];
+
+    memset(p_rec, 0, sizeof(*p_rec));
+    p_rec->minute = acc.minute;
+
+    if (acc.num_beats > 0)
+    {
+        p_rec->hr_min_bpm = (uint8_t) MIN(roundf(60000.0f / acc.ibi_max_ms), UINT8_MAX);
+        p_rec->hr_mean_bpm = (uint8_t) MIN(roundf(60000.0f * acc.num_beats / acc.ibi_sum_ms), UINT8_MAX);
+        p_rec->hr_max_bpm = (uint8_t) MIN(roundf(60000.0f / acc.ibi_min_ms), UINT8_MAX);
+        p_rec->num_beats = (uint8_t) MIN(acc.num_beats, UINT8_MAX);
+    }
+
+    if (acc.num_tonic > 0)
+    {
+        p_rec->tonic_ns = (uint16_t) MIN((acc.tonic_sum_ns + acc.num_tonic / 2) / acc.num_tonic, UINT16_MAX);
+    }
+
+    p_rec->num_scr = (uint8_t) MIN(acc.num_scr, UINT8_MAX);
+
+    for (size_t i = 0; i < SUMMARY_NUM_HR_ZONES; i++)
+    {
+        p_rec->zone_s[i] = (uint8_t) MIN(roundf(acc.zone_ms[i] / 1000.0f), UINT8_MAX);
+        zone_total_ms[i] += (uint64_t) acc.zone_ms[i];
+    }
+
+    record_head = (record_head + 1) % SUMMARY_NUM_RECORDS;
+    if (num_records < SUMMARY_NUM_RECORDS)
+    {
+        num_records++;
+    }
+
+    memset(&acc, 0, sizeof(acc));
+}
+
+static size_t hr_zone(float bpm)
+{
+    size_t zone = 0;
+
+    while ((zone < ARRAY_SIZE(hr_zone_bpm)) && (bpm >= hr_zone_bpm[zone]))
+    {
+        zone++;
+    }
+
+    return zone;
+}
+
+#if defined(CONFIG_SHELL)
+
+static int cmd_summary(const struct shell *sh, size_t argc, char **argv)
+{
+    uint8_t buf[SUMMARY_HEADER_LEN + 10 * SUMMARY_RECORD_LEN];
+    const uint8_t *p_rec;
+    int64_t now_us = timebase_now_us();
+    uint32_t now_minute = (uint32_t) (now_us / US_PER_MINUTE);
+    size_t len;
+    uint8_t num;
+
+    // The last ten minutes
+    len = summary_serialize(now_us, (now_minute > 10) ? (now_minute - 10) : 0,
+                            buf, sizeof(buf));
+    if (len < SUMMARY_HEADER_LEN)
+    {
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < SUMMARY_NUM_HR_ZONES; i++)
+    {
+        shell_print(sh, "zone %u (from %u bpm): %u s", (unsigned int) i,
+                    (0 == i) ? 0 : hr_zone_bpm[i - 1],
+                    sys_get_le32(&buf[5 + (SUMMARY_NUM_HR_ZONES - 1) + i * sizeof(uint32_t)]));
+    }
+
+    num = buf[SUMMARY_HEADER_LEN - 1];
+
+    for (size_t i = 0; i < num; i++)
+    {
+        p_rec = &buf[SUMMARY_HEADER_LEN + i * SUMMARY_RECORD_LEN];
+        shell_print(sh, "minute %u: HR %u/%u/%u bpm (%u beats), tonic %u nS, %u SCRs",
+                    sys_get_le32(p_rec), p_rec[4], p_rec[5], p_rec[6], p_rec[7],
+                    sys_get_le16(&p_rec[8]), p_rec[10]);
+    }
+
+    return 0;
+}
+
+SHELL_CMD_REGISTER(summary, NULL, "HR zone totals and the last per-minute summaries", cmd_summary);
+
+#endif /* CONFIG_SHELL */
\ No newline at end of file
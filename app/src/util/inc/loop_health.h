@@ -0,0 +1,45 @@
+#ifndef _LOOP_HEALTH_H_
+#define _LOOP_HEALTH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <zephyr/kernel.h>
+
+// Jitter histogram bins: [0, 32) us, [32, 64) us, ... [2048, 4096) us, >= 4096 us
+#define LOOP_HEALTH_HIST_BINS 9
+#define LOOP_HEALTH_HIST_FIRST_US 32
+
+// Serialized size of one loop, see loop_health_serialize()
+#define LOOP_HEALTH_ENTRY_LEN ((3 + LOOP_HEALTH_HIST_BINS) * sizeof(uint32_t))
+
+typedef struct loop_health_stats
+{
+    uint32_t num_wakeups;
+    uint32_t num_missed;
+    uint32_t max_jitter_us;
+    uint32_t hist[LOOP_HEALTH_HIST_BINS];
+} loop_health_stats_t;
+
+typedef struct loop_health
+{
+    const char *p_name;
+    uint32_t period_us;
+    uint32_t last_wakeup_cyc;
+    bool have_last_wakeup;
+    loop_health_stats_t stats;
+    struct k_spinlock lock;
+    struct loop_health *p_next;
+} loop_health_t;
+
+int loop_health_init(loop_health_t *p_health, const char *p_name, uint32_t period_us);
+
+uint32_t loop_health_wakeup(loop_health_t *p_health, uint32_t expirations);
+
+void loop_health_restart(loop_health_t *p_health);
+
+int loop_health_get(loop_health_t *p_health, loop_health_stats_t *p_stats);
+
+size_t loop_health_serialize(uint8_t *p_buf, size_t size);
+
+#endif /* _LOOP_HEALTH_H_ */
@@ -0,0 +1,29 @@
+#ifndef _MEDIAN_FILTER_H_
+#define _MEDIAN_FILTER_H_
+
+#include <stddef.h>
+#include <zephyr/kernel.h>
+
+typedef struct median_filter
+{
+    size_t size;
+    size_t idx;
+    size_t num_items;
+    float *p_data;
+    int *p_pos;
+    int *p_heap;
+    struct k_mutex mutex;
+} median_filter_t;
+
+int median_filter_init(median_filter_t *p_filt, float *p_data, int *p_pos,
+                       int *p_heap, size_t size);
+
+int median_filter_clear(median_filter_t *p_filt);
+
+int median_filter_put(median_filter_t *p_filt, float item);
+
+int median_filter_get(median_filter_t *p_filt, float *p_res);
+
+size_t median_filter_get_num_items(median_filter_t *p_filt);
+
+#endif /* _MEDIAN_FILTER_H_ */
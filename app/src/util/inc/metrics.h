@@ -0,0 +1,50 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef enum metrics_topic
+{
+    METRICS_TOPIC_PPG,
+    METRICS_TOPIC_EDA,
+    METRICS_TOPIC_NUM,
+} metrics_topic_t;
+
+typedef struct metrics_ppg
+{
+    int64_t ts_us;          // Beat the metrics last changed at, shared timebase
+    uint16_t hr_bpm;
+    uint16_t rmssd_ms;
+    uint16_t amplitude;
+    uint16_t amplitude_sd;
+    uint16_t hr_min_bpm;
+    uint16_t hr_max_bpm;
+    uint16_t lf_power;
+    uint16_t hf_power;
+    uint16_t lf_hf_ratio;   // * 100
+    uint8_t spo2_pct;
+    uint8_t sqi;
+    uint8_t resp_bpm;
+    uint8_t resp_quality;   // resp_quality_t
+    uint16_t reserved;
+} metrics_ppg_t;
+
+typedef struct metrics_eda
+{
+    int64_t ts_us;          // Filtered sample the metrics last changed at
+    uint16_t epc;
+    uint16_t tonic_ns;
+    uint16_t range_ns;
+    uint8_t scr_per_min;
+    uint8_t reserved;
+} metrics_eda_t;
+
+bool metrics_publish(metrics_topic_t topic, const void *p_data, size_t size);
+
+uint32_t metrics_read(metrics_topic_t topic, void *p_data, size_t size);
+
+uint32_t metrics_get_version(metrics_topic_t topic);
+
+#endif /* _METRICS_H_ */
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zephyr/kernel.h>
+
+typedef enum prof_stage
+{
+    PROF_STAGE_PPG_LOOP,
+    PROF_STAGE_CHECK_FOR_BEAT,
+    PROF_STAGE_RMSSD,
+    PROF_STAGE_EDA_LOOP,
+    PROF_STAGE_FIR_FILTER,
+    PROF_STAGE_EPC,
+    PROF_STAGE_BT_NOTIFY,
+    PROF_STAGE_RESP,
+    PROF_STAGE_HRV,
+    PROF_STAGE_NUM,
+} prof_stage_t;
+
+typedef struct prof_stats
+{
+    uint32_t min;
+    uint32_t max;
+    uint32_t avg;
+    uint32_t count;
+    uint32_t budget_us;
+} prof_stats_t;
+
+#if defined(CONFIG_APP_PROFILING)
+
+#define PROF_START(stage) uint32_t prof_start_##stage = k_cycle_get_32()
+#define PROF_STOP(stage) prof_record(stage, k_cycle_get_32() - prof_start_##stage)
+#define PROF_SET_BUDGET_US(stage, us) prof_set_budget_us(stage, us)
+
+#else
+
+#define PROF_START(stage)
+#define PROF_STOP(stage)
+#define PROF_SET_BUDGET_US(stage, us)
+
+#endif /* CONFIG_APP_PROFILING */
+
+void prof_record(prof_stage_t stage, uint32_t cycles);
+void prof_set_budget_us(prof_stage_t stage, uint32_t budget_us);
+int prof_get(prof_stage_t stage, prof_stats_t *p_stats);
+const char *prof_get_name(prof_stage_t stage);
+void prof_reset(void);
+size_t prof_serialize(uint8_t *p_buf, size_t size);
+
+#endif /* _PROF_H_ */
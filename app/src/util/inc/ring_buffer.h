@@ -2,8 +2,17 @@
 #define _RING_BUFFER_H_
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <zephyr/kernel.h>
 
+// Monotonic deque of buffer positions, used for the sliding min and max
+typedef struct ring_buffer_deque
+{
+    size_t *p_pos;
+    size_t first;
+    size_t num;
+} ring_buffer_deque_t;
+
 typedef struct ring_buffer
 {
     size_t head;
@@ -12,16 +21,41 @@ typedef struct ring_buffer
     float sum;
     float *p_buf;
     struct k_mutex mutex;
+    bool var_enabled;
+    float mean;
+    float m2;
+    ring_buffer_deque_t min_deque;
+    ring_buffer_deque_t max_deque;
 } ring_buffer_t;
 
+// Called for each contiguous span of the window, oldest first. Runs with the
+// buffer locked, so it must not call back into the same ring buffer.
+typedef void (*ring_buffer_visitor_t)(const float *p_items, size_t num_items, void *p_ctx);
+
 int ring_buffer_init(ring_buffer_t *p_ring_buf, float *p_buf, size_t size);
 
+int ring_buffer_clear(ring_buffer_t *p_ring_buf);
+
 int ring_buffer_put(ring_buffer_t *p_ring_buf, float item);
 
+int ring_buffer_enable_var(ring_buffer_t *p_ring_buf);
+
+int ring_buffer_enable_min_max(ring_buffer_t *p_ring_buf, size_t *p_min_pos, size_t *p_max_pos);
+
 int ring_buffer_mov_avg(ring_buffer_t *p_ring_buf, float *p_res);
 
+int ring_buffer_sum(ring_buffer_t *p_ring_buf, float *p_res);
+
+int ring_buffer_var(ring_buffer_t *p_ring_buf, float *p_res);
+
+int ring_buffer_min(ring_buffer_t *p_ring_buf, float *p_res);
+
+int ring_buffer_max(ring_buffer_t *p_ring_buf, float *p_res);
+
 int ring_buffer_copy_inorder(ring_buffer_t *p_ring_buf, float *p_dest);
 
+int ring_buffer_visit(ring_buffer_t *p_ring_buf, ring_buffer_visitor_t visitor, void *p_ctx);
+
 size_t ring_buffer_get_num_items(ring_buffer_t *p_ring_buf);
 
 #endif /* _RING_BUFFER_H_ */
\ No newline at end of file
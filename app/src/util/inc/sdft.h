@@ -0,0 +1,37 @@
+#ifndef _SDFT_H_
+#define _SDFT_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Floats of the bin array for num_bins tracked bins: real and imaginary part
+// of each bin, then its twiddle factor
+#define SDFT_BINS_LEN(num_bins) (4 * (num_bins))
+
+typedef struct sdft
+{
+    size_t win_len;
+    size_t first_bin;
+    size_t num_bins;
+    size_t idx;
+    size_t num_items;
+    float damping_pow_n;
+    float *p_hist;
+    float *p_bin_re;
+    float *p_bin_im;
+    float *p_twiddle_re;
+    float *p_twiddle_im;
+} sdft_t;
+
+int sdft_init(sdft_t *p_sdft, float *p_hist, size_t win_len, float *p_bins,
+              size_t first_bin, size_t num_bins);
+
+int sdft_clear(sdft_t *p_sdft);
+
+int sdft_push(sdft_t *p_sdft, float x);
+
+bool sdft_is_full(const sdft_t *p_sdft);
+
+float sdft_power(const sdft_t *p_sdft, size_t bin);
+
+#endif /* _SDFT_H_ */
\ No newline at end of file
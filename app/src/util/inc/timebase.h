@@ -0,0 +1,23 @@
+#ifndef _TIMEBASE_H_
+#define _TIMEBASE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Maps the sample count of one stream onto the shared timebase
+typedef struct timebase_clock
+{
+    int64_t origin_us;  // Time of sample 0
+    uint32_t period_us;
+    bool synced;
+} timebase_clock_t;
+
+int64_t timebase_now_us(void);
+
+int timebase_clock_init(timebase_clock_t *p_clock, uint32_t period_us);
+
+void timebase_clock_sync(timebase_clock_t *p_clock, uint64_t num_samples, int64_t now_us);
+
+int64_t timebase_clock_get_us(const timebase_clock_t *p_clock, int64_t sample_q, uint8_t frac_bits);
+
+#endif /* _TIMEBASE_H_ */
\ No newline at end of file
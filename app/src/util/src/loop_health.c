@@ -0,0 +1,179 @@
+/**
+ * Deadline accounting for periodic sampling loops.
+ *
+ * A loop reports every wake-up together with the number of timer expirations
+ * since the previous one, as returned by k_timer_status_sync(). More than one
+ * expiration means sampling periods were missed. The time between wake-ups
+ * is compared against the expected expirations * period and the absolute
+ * difference goes into a histogram of wake-up jitter.
+ *
+ * Every initialised loop is linked into a list, so all of them can be
+ * reported from one place.
+*/
+
+#include "loop_health.h"
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/shell/shell.h>
+
+static loop_health_t *p_health_list;
+
+int loop_health_init(loop_health_t *p_health, const char *p_name, uint32_t period_us)
+{
+    if (p_health && p_name && (period_us > 0))
+    {
+        memset(&p_health->stats, 0, sizeof(p_health->stats));
+        p_health->p_name = p_name;
+        p_health->period_us = period_us;
+        p_health->have_last_wakeup = false;
+
+        p_health->p_next = p_health_list;
+        p_health_list = p_health;
+
+        return 0;
+    }
+
+    return -1;
+}
+
+// Returns the number of sampling periods missed before this wake-up
+uint32_t loop_health_wakeup(loop_health_t *p_health, uint32_t expirations)
+{
+    uint32_t now_cyc = k_cycle_get_32();
+    uint32_t missed = (expirations > 1) ? (expirations - 1) : 0;
+    uint32_t interval_us;
+    uint32_t expected_us;
+    uint32_t jitter_us;
+    size_t bin;
+    k_spinlock_key_t key;
+
+    key = k_spin_lock(&p_health->lock);
+
+    p_health->stats.num_wakeups++;
+    p_health->stats.num_missed += missed;
+
+    if (p_health->have_last_wakeup && (expirations > 0))
+    {
+        interval_us = k_cyc_to_us_floor32(now_cyc - p_health->last_wakeup_cyc);
+        expected_us = expirations * p_health->period_us;
+        jitter_us = (interval_us > expected_us) ? (interval_us - expected_us)
+                                                : (expected_us - interval_us);
+
+        if (jitter_us > p_health->stats.max_jitter_us)
+        {
+            p_health->stats.max_jitter_us = jitter_us;
+        }
+
+        for (bin = 0; bin < LOOP_HEALTH_HIST_BINS - 1; bin++)
+        {
+            if (jitter_us < (LOOP_HEALTH_HIST_FIRST_US << bin))
+            {
+                break;
+            }
+        }
+        p_health->stats.hist[bin]++;
+    }
+
+    p_health->last_wakeup_cyc = now_cyc;
+    p_health->have_last_wakeup = true;
+
+    k_spin_unlock(&p_health->lock, key);
+
+    return missed;
+}
+
+// Forget the previous wake-up, e.g. after the sampling timer was restarted
+void loop_health_restart(loop_health_t *p_health)
+{
+    k_spinlock_key_t key = k_spin_lock(&p_health->lock);
+
+    p_health->have_last_wakeup = false;
+
+    k_spin_unlock(&p_health->lock, key);
+}
+
+int loop_health_get(loop_health_t *p_health, loop_health_stats_t *p_stats)
+{
+    k_spinlock_key_t key;
+
+    if (p_health && p_stats)
+    {
+        key = k_spin_lock(&p_health->lock);
+        *p_stats = p_health->stats;
+        k_spin_unlock(&p_health->lock, key);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Packs wake-ups, missed periods, max jitter and the jitter histogram of
+ * every loop as little endian uint32, in reverse order of initialisation.
+ * Returns the number of bytes written.
+*/
+size_t loop_health_serialize(uint8_t *p_buf, size_t size)
+{
+    loop_health_stats_t stats;
+    size_t len = 0;
+
+    for (loop_health_t *p = p_health_list; p; p = p->p_next)
+    {
+        if (len + LOOP_HEALTH_ENTRY_LEN > size)
+        {
+            break;
+        }
+
+        loop_health_get(p, &stats);
+
+        sys_put_le32(stats.num_wakeups, &p_buf[len]);
+        sys_put_le32(stats.num_missed, &p_buf[len + 4]);
+        sys_put_le32(stats.max_jitter_us, &p_buf[len + 8]);
+        len += 3 * sizeof(uint32_t);
+
+        for (size_t i = 0; i < LOOP_HEALTH_HIST_BINS; i++)
+        {
+            sys_put_le32(stats.hist[i], &p_buf[len]);
+            len += sizeof(uint32_t);
+        }
+    }
+
+    return len;
+}
+
+#if defined(CONFIG_SHELL)
+
+static int cmd_health(const struct shell *sh, size_t argc, char **argv)
+{
+    loop_health_stats_t stats;
+
+    for (loop_health_t *p = p_health_list; p; p = p->p_next)
+    {
+        loop_health_get(p, &stats);
+
+        shell_print(sh, "%s: %u wake-ups, %u missed periods, max jitter %u us",
+                    p->p_name, stats.num_wakeups, stats.num_missed,
+                    stats.max_jitter_us);
+
+        for (size_t i = 0; i < LOOP_HEALTH_HIST_BINS; i++)
+        {
+            if (i < LOOP_HEALTH_HIST_BINS - 1)
+            {
+                shell_print(sh, "  < %5u us: %u", LOOP_HEALTH_HIST_FIRST_US << i,
+                            stats.hist[i]);
+            }
+            else
+            {
+                shell_print(sh, " >= %5u us: %u", LOOP_HEALTH_HIST_FIRST_US << (i - 1),
+                            stats.hist[i]);
+            }
+        }
+    }
+
+    return 0;
+}
+
+SHELL_CMD_REGISTER(health, NULL, "Sampling loop deadline and jitter counters", cmd_health);
+
+#endif /* CONFIG_SHELL */
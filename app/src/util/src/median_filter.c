@@ -0,0 +1,284 @@
+/**
+ * Sliding window median over the last N items, updated in O(log N) per item.
+ *
+ * The window is split into a max-heap of the items below the median and a
+ * min-heap of the items above it, stored back to back in one array with the
+ * median at index 0: negative heap indexes belong to the max-heap and
+ * positive ones to the min-heap. Every item in the circular data buffer
+ * remembers its heap index, so the oldest item can be replaced in place and
+ * sifted up or down without searching for it.
+ *
+ * The caller provides three arrays of `size` elements: the item storage and
+ * two index arrays used for the heap bookkeeping.
+*/
+
+#include "median_filter.h"
+
+static bool heap_less(median_filter_t *p_filt, int i, int j);
+static bool heap_swap_if_less(median_filter_t *p_filt, int i, int j);
+static void min_heap_sift_down(median_filter_t *p_filt, int i);
+static void max_heap_sift_down(median_filter_t *p_filt, int i);
+static bool min_heap_sift_up(median_filter_t *p_filt, int i);
+static bool max_heap_sift_up(median_filter_t *p_filt, int i);
+
+// Number of items in the min-heap and max-heap, the median is not counted
+#define MIN_HEAP_NUM(p_filt) ((int) ((p_filt)->num_items - 1) / 2)
+#define MAX_HEAP_NUM(p_filt) ((int) (p_filt)->num_items / 2)
+
+// Heap slot for heap index i, which can be negative
+#define HEAP(p_filt, i) ((p_filt)->p_heap[(int) (p_filt)->size / 2 + (i)])
+
+int median_filter_init(median_filter_t *p_filt, float *p_data, int *p_pos,
+                       int *p_heap, size_t size)
+{
+    if (p_filt && p_data && p_pos && p_heap && (size > 0))
+    {
+        p_filt->size = size;
+        p_filt->p_data = p_data;
+        p_filt->p_pos = p_pos;
+        p_filt->p_heap = p_heap;
+
+        k_mutex_init(&p_filt->mutex);
+
+        return median_filter_clear(p_filt);
+    }
+
+    return -1;
+}
+
+// Empties the window, the filter stays initialised
+int median_filter_clear(median_filter_t *p_filt)
+{
+    int pos;
+
+    if (p_filt && p_filt->p_data)
+    {
+        k_mutex_lock(&p_filt->mutex, K_FOREVER);
+
+        p_filt->idx = 0;
+        p_filt->num_items = 0;
+
+        // Initial fill order alternates between the median, the max-heap
+        // and the min-heap: 0, -1, 1, -2, 2, ...
+        for (size_t i = 0; i < p_filt->size; i++)
+        {
+            pos = (int) ((i + 1) / 2);
+            pos = (i & 1) ? -pos : pos;
+            p_filt->p_pos[i] = pos;
+            HEAP(p_filt, pos) = (int) i;
+        }
+
+        k_mutex_unlock(&p_filt->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+int median_filter_put(median_filter_t *p_filt, float item)
+{
+    bool is_new;
+    int pos;
+    float old;
+
+    if (p_filt && p_filt->p_data)
+    {
+        k_mutex_lock(&p_filt->mutex, K_FOREVER);
+
+        is_new = (p_filt->num_items < p_filt->size);
+        pos = p_filt->p_pos[p_filt->idx];
+        old = p_filt->p_data[p_filt->idx];
+
+        p_filt->p_data[p_filt->idx] = item;
+        p_filt->idx = (p_filt->idx + 1) % p_filt->size;
+        if (is_new)
+        {
+            p_filt->num_items += 1;
+        }
+
+        if (pos > 0)
+        {
+            // Replaced item is in the min-heap
+            if (!is_new && (old < item))
+            {
+                min_heap_sift_down(p_filt, pos);
+            }
+            else if (min_heap_sift_up(p_filt, pos))
+            {
+                max_heap_sift_down(p_filt, 0);
+            }
+        }
+        else if (pos < 0)
+        {
+            // Replaced item is in the max-heap
+            if (!is_new && (item < old))
+            {
+                max_heap_sift_down(p_filt, pos);
+            }
+            else if (max_heap_sift_up(p_filt, pos))
+            {
+                min_heap_sift_down(p_filt, 0);
+            }
+        }
+        else
+        {
+            // Replaced item is the median
+            max_heap_sift_down(p_filt, 0);
+            min_heap_sift_down(p_filt, 0);
+        }
+
+        k_mutex_unlock(&p_filt->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+// Median of the window, the mean of the two middle items if the number of
+// items is even
+int median_filter_get(median_filter_t *p_filt, float *p_res)
+{
+    if (p_filt && p_res)
+    {
+        k_mutex_lock(&p_filt->mutex, K_FOREVER);
+
+        if (0 == p_filt->num_items)
+        {
+            *p_res = 0.0f;
+        }
+        else if (p_filt->num_items & 1)
+        {
+            *p_res = p_filt->p_data[HEAP(p_filt, 0)];
+        }
+        else
+        {
+            *p_res = (p_filt->p_data[HEAP(p_filt, 0)]
+                      + p_filt->p_data[HEAP(p_filt, -1)]) / 2.0f;
+        }
+
+        k_mutex_unlock(&p_filt->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+size_t median_filter_get_num_items(median_filter_t *p_filt)
+{
+    size_t num_items = 0;
+
+    if (p_filt)
+    {
+        k_mutex_lock(&p_filt->mutex, K_FOREVER);
+
+        num_items = p_filt->num_items;
+
+        k_mutex_unlock(&p_filt->mutex);
+    }
+
+    return num_items;
+}
+
+static bool heap_less(median_filter_t *p_filt, int i, int j)
+{
+    return p_filt->p_data[HEAP(p_filt, i)] < p_filt->p_data[HEAP(p_filt, j)];
+}
+
+// Swaps heap items i and j if item i is smaller, returns true if swapped
+static bool heap_swap_if_less(median_filter_t *p_filt, int i, int j)
+{
+    int tmp;
+
+    if (!heap_less(p_filt, i, j))
+    {
+        return false;
+    }
+
+    tmp = HEAP(p_filt, i);
+    HEAP(p_filt, i) = HEAP(p_filt, j);
+    HEAP(p_filt, j) = tmp;
+
+    p_filt->p_pos[HEAP(p_filt, i)] = i;
+    p_filt->p_pos[HEAP(p_filt, j)] = j;
+
+    return true;
+}
+
+// The median at index 0 is the root of both heaps, its only min-heap child is
+// 1 and its only max-heap child is -1
+static void min_heap_sift_down(median_filter_t *p_filt, int i)
+{
+    int child;
+
+    for (;;)
+    {
+        child = (0 == i) ? 1 : 2 * i;
+        if (child > MIN_HEAP_NUM(p_filt))
+        {
+            break;
+        }
+
+        // Pick the smaller child
+        if ((i != 0) && (child < MIN_HEAP_NUM(p_filt)) && heap_less(p_filt, child + 1, child))
+        {
+            child++;
+        }
+        if (!heap_swap_if_less(p_filt, child, i))
+        {
+            break;
+        }
+
+        i = child;
+    }
+}
+
+static void max_heap_sift_down(median_filter_t *p_filt, int i)
+{
+    int child;
+
+    for (;;)
+    {
+        child = (0 == i) ? -1 : 2 * i;
+        if (child < -MAX_HEAP_NUM(p_filt))
+        {
+            break;
+        }
+
+        // Pick the larger child
+        if ((i != 0) && (child > -MAX_HEAP_NUM(p_filt)) && heap_less(p_filt, child, child - 1))
+        {
+            child--;
+        }
+        if (!heap_swap_if_less(p_filt, i, child))
+        {
+            break;
+        }
+
+        i = child;
+    }
+}
+
+// Returns true if the item reached the median slot
+static bool min_heap_sift_up(median_filter_t *p_filt, int i)
+{
+    while ((i > 0) && heap_swap_if_less(p_filt, i, i / 2))
+    {
+        i /= 2;
+    }
+
+    return (0 == i);
+}
+
+// Returns true if the item reached the median slot
+static bool max_heap_sift_up(median_filter_t *p_filt, int i)
+{
+    while ((i < 0) && heap_swap_if_less(p_filt, i / 2, i))
+    {
+        i /= 2;
+    }
+
+    return (0 == i);
+}
@@ -0,0 +1,164 @@
+/**
+ * Central registry of the latest metrics snapshots.
+ *
+ * Each topic has a single producer thread which publishes a complete
+ * snapshot struct at once. Consumers read a consistent copy without taking
+ * a lock, using a sequence counter: it is odd while a write is in progress
+ * and a read is retried if the counter changed while copying. The producer
+ * locks the scheduler for the duration of the copy, so a higher priority
+ * reader never spins on a preempted write. Readers must not run in ISRs.
+ *
+ * The version of a topic only changes when the published metrics differ from
+ * the previous snapshot, so consumers can skip topics that did not change.
+ * The timestamp is not compared, a snapshot keeps the time of the last
+ * change.
+*/
+
+#include "metrics.h"
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+#include <zephyr/shell/shell.h>
+
+typedef struct metrics_entry
+{
+    atomic_t seq;
+    uint32_t version;
+    void *p_data;
+    size_t size;
+    size_t cmp_offset;  // Start of the metrics, past the timestamp
+} metrics_entry_t;
+
+static metrics_ppg_t ppg_data;
+static metrics_eda_t eda_data;
+
+static metrics_entry_t entries[METRICS_TOPIC_NUM] = {
+    [METRICS_TOPIC_PPG] = {
+        .p_data = &ppg_data,
+        .size = sizeof(ppg_data),
+        .cmp_offset = offsetof(metrics_ppg_t, hr_bpm),
+    },
+    [METRICS_TOPIC_EDA] = {
+        .p_data = &eda_data,
+        .size = sizeof(eda_data),
+        .cmp_offset = offsetof(metrics_eda_t, epc),
+    },
+};
+
+// Returns true if the metrics differ from the previous snapshot. A snapshot
+// that only has a new timestamp is dropped.
+bool metrics_publish(metrics_topic_t topic, const void *p_data, size_t size)
+{
+    metrics_entry_t *p_entry;
+
+    if ((topic >= METRICS_TOPIC_NUM) || !p_data || (size != entries[topic].size))
+    {
+        return false;
+    }
+
+    p_entry = &entries[topic];
+
+    // Only the producer writes, so the comparison needs no protection
+    if (0 == memcmp((const uint8_t *) p_entry->p_data + p_entry->cmp_offset,
+                    (const uint8_t *) p_data + p_entry->cmp_offset,
+                    size - p_entry->cmp_offset))
+    {
+        return false;
+    }
+
+    k_sched_lock();
+
+    atomic_inc(&p_entry->seq);
+    barrier_dmem_fence_full();
+
+    memcpy(p_entry->p_data, p_data, size);
+    p_entry->version++;
+
+    barrier_dmem_fence_full();
+    atomic_inc(&p_entry->seq);
+
+    k_sched_unlock();
+
+    return true;
+}
+
+// Copies the latest snapshot and returns its version, 0 if nothing was
+// published yet
+uint32_t metrics_read(metrics_topic_t topic, void *p_data, size_t size)
+{
+    metrics_entry_t *p_entry;
+    atomic_val_t seq;
+    uint32_t version;
+
+    if ((topic >= METRICS_TOPIC_NUM) || !p_data || (size != entries[topic].size))
+    {
+        return 0;
+    }
+
+    p_entry = &entries[topic];
+
+    do
+    {
+        seq = atomic_get(&p_entry->seq);
+        barrier_dmem_fence_full();
+
+        memcpy(p_data, p_entry->p_data, size);
+        version = p_entry->version;
+
+        barrier_dmem_fence_full();
+    } while ((seq & 1) || (seq != atomic_get(&p_entry->seq)));
+
+    return version;
+}
+
+uint32_t metrics_get_version(metrics_topic_t topic)
+{
+    metrics_entry_t *p_entry;
+    atomic_val_t seq;
+    uint32_t version;
+
+    if (topic >= METRICS_TOPIC_NUM)
+    {
+        return 0;
+    }
+
+    p_entry = &entries[topic];
+
+    do
+    {
+        seq = atomic_get(&p_entry->seq);
+        barrier_dmem_fence_full();
+        version = p_entry->version;
+        barrier_dmem_fence_full();
+    } while ((seq & 1) || (seq != atomic_get(&p_entry->seq)));
+
+    return version;
+}
+
+#if defined(CONFIG_SHELL)
+
+static int cmd_metrics(const struct shell *sh, size_t argc, char **argv)
+{
+    metrics_ppg_t ppg;
+    metrics_eda_t eda;
+    uint32_t version;
+
+    version = metrics_read(METRICS_TOPIC_PPG, &ppg, sizeof(ppg));
+    shell_print(sh, "ppg (v%u): HR %u (%u-%u), RMSSD %u, ampl %u (SD %u), "
+                "LF %u, HF %u, LF/HF %u, SpO2 %u, SQI %u",
+                version, ppg.hr_bpm, ppg.hr_min_bpm, ppg.hr_max_bpm,
+                ppg.rmssd_ms, ppg.amplitude, ppg.amplitude_sd, ppg.lf_power,
+                ppg.hf_power, ppg.lf_hf_ratio, ppg.spo2_pct, ppg.sqi);
+
+    version = metrics_read(METRICS_TOPIC_EDA, &eda, sizeof(eda));
+    shell_print(sh, "eda (v%u): EPC %u, tonic %u nS, range %u nS, SCR/min %u",
+                version, eda.epc, eda.tonic_ns, eda.range_ns, eda.scr_per_min);
+
+    return 0;
+}
+
+SHELL_CMD_REGISTER(metrics, NULL, "Latest published metrics", cmd_metrics);
+
+#endif /* CONFIG_SHELL */
\ No newline at end of file
@@ -0,0 +1,195 @@
+/**
+ * Per-stage cycle counters for profiling the signal processing on target.
+ *
+ * Stages are timed with PROF_START()/PROF_STOP() around the code of interest,
+ * which compile to nothing unless CONFIG_APP_PROFILING is set. Stages that
+ * run once per sampling period can be given a budget, so the report shows
+ * how close the loop is to overrunning.
+*/
+
+#include "prof.h"
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/shell/shell.h>
+
+typedef struct prof_entry
+{
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t count;
+    uint32_t budget_us;
+} prof_entry_t;
+
+static const char *const stage_names[PROF_STAGE_NUM] = {
+    [PROF_STAGE_PPG_LOOP] = "ppg_loop",
+    [PROF_STAGE_CHECK_FOR_BEAT] = "checkForBeat",
+    [PROF_STAGE_RMSSD] = "ppg_get_rmssd",
+    [PROF_STAGE_EDA_LOOP] = "eda_loop",
+    [PROF_STAGE_FIR_FILTER] = "fir_filter",
+    [PROF_STAGE_EPC] = "eda_get_epc",
+    [PROF_STAGE_BT_NOTIFY] = "bt_send_notification",
+    [PROF_STAGE_RESP] = "resp_put_beat",
+    [PROF_STAGE_HRV] = "hrv_put_ibi",
+};
+
+static prof_entry_t entries[PROF_STAGE_NUM];
+static struct k_spinlock prof_lock;
+
+void prof_record(prof_stage_t stage, uint32_t cycles)
+{
+    k_spinlock_key_t key;
+    prof_entry_t *p_entry;
+
+    if (stage >= PROF_STAGE_NUM)
+    {
+        return;
+    }
+
+    p_entry = &entries[stage];
+
+    key = k_spin_lock(&prof_lock);
+
+    if ((0 == p_entry->count) || (cycles < p_entry->min))
+    {
+        p_entry->min = cycles;
+    }
+    if (cycles > p_entry->max)
+    {
+        p_entry->max = cycles;
+    }
+    p_entry->sum += cycles;
+    p_entry->count++;
+
+    k_spin_unlock(&prof_lock, key);
+}
+
+void prof_set_budget_us(prof_stage_t stage, uint32_t budget_us)
+{
+    if (stage < PROF_STAGE_NUM)
+    {
+        entries[stage].budget_us = budget_us;
+    }
+}
+
+int prof_get(prof_stage_t stage, prof_stats_t *p_stats)
+{
+    k_spinlock_key_t key;
+    prof_entry_t *p_entry;
+
+    if ((stage >= PROF_STAGE_NUM) || !p_stats)
+    {
+        return -1;
+    }
+
+    p_entry = &entries[stage];
+
+    key = k_spin_lock(&prof_lock);
+
+    p_stats->min = p_entry->min;
+    p_stats->max = p_entry->max;
+    p_stats->avg = p_entry->count ? (uint32_t) (p_entry->sum / p_entry->count) : 0;
+    p_stats->count = p_entry->count;
+    p_stats->budget_us = p_entry->budget_us;
+
+    k_spin_unlock(&prof_lock, key);
+
+    return 0;
+}
+
+const char *prof_get_name(prof_stage_t stage)
+{
+    return (stage < PROF_STAGE_NUM) ? stage_names[stage] : "";
+}
+
+void prof_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&prof_lock);
+
+    for (size_t i = 0; i < PROF_STAGE_NUM; i++)
+    {
+        entries[i].min = 0;
+        entries[i].max = 0;
+        entries[i].sum = 0;
+        entries[i].count = 0;
+    }
+
+    k_spin_unlock(&prof_lock, key);
+}
+
+/**
+ * Packs min, avg and max cycles of every stage as little endian uint32, in
+ * prof_stage_t order. Returns the number of bytes written.
+*/
+size_t prof_serialize(uint8_t *p_buf, size_t size)
+{
+    prof_stats_t stats;
+    size_t len = 0;
+
+    for (size_t i = 0; i < PROF_STAGE_NUM; i++)
+    {
+        if (len + 3 * sizeof(uint32_t) > size)
+        {
+            break;
+        }
+
+        prof_get((prof_stage_t) i, &stats);
+
+        sys_put_le32(stats.min, &p_buf[len]);
+        sys_put_le32(stats.avg, &p_buf[len + 4]);
+        sys_put_le32(stats.max, &p_buf[len + 8]);
+        len += 3 * sizeof(uint32_t);
+    }
+
+    return len;
+}
+
+#if defined(CONFIG_SHELL)
+
+static int cmd_prof_show(const struct shell *sh, size_t argc, char **argv)
+{
+    prof_stats_t stats;
+
+    shell_print(sh, "%-22s %10s %10s %10s %10s %6s", "stage", "count",
+                "min [us]", "avg [us]", "max [us]", "load");
+
+    for (size_t i = 0; i < PROF_STAGE_NUM; i++)
+    {
+        prof_get((prof_stage_t) i, &stats);
+
+        if (stats.budget_us)
+        {
+            shell_print(sh, "%-22s %10u %10u %10u %10u %5u%%", stage_names[i],
+                        stats.count, k_cyc_to_us_floor32(stats.min),
+                        k_cyc_to_us_floor32(stats.avg), k_cyc_to_us_floor32(stats.max),
+                        100U * k_cyc_to_us_floor32(stats.max) / stats.budget_us);
+        }
+        else
+        {
+            shell_print(sh, "%-22s %10u %10u %10u %10u %6s", stage_names[i],
+                        stats.count, k_cyc_to_us_floor32(stats.min),
+                        k_cyc_to_us_floor32(stats.avg), k_cyc_to_us_floor32(stats.max),
+                        "-");
+        }
+    }
+
+    return 0;
+}
+
+static int cmd_prof_reset(const struct shell *sh, size_t argc, char **argv)
+{
+    prof_reset();
+    shell_print(sh, "Profiling counters reset");
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(prof_cmds,
+    SHELL_CMD(show, NULL, "Show per-stage cycle counters", cmd_prof_show),
+    SHELL_CMD(reset, NULL, "Reset per-stage cycle counters", cmd_prof_reset),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(prof, &prof_cmds, "Signal processing profiling", NULL);
+
+#endif /* CONFIG_SHELL */
@@ -2,24 +2,88 @@
  * A custom ring buffer implementation that overwrites older samples. Useful for
  * implementing moving averages and sliding windows. Currently supports only
  * floating point numbers as buffer items.
+ *
+ * Variance (Welford) and sliding min/max (monotonic deques) can be enabled
+ * per instance and are then updated in O(1) amortized on every put. The
+ * running sums are recomputed exactly each time the head circles around, so
+ * rounding errors do not accumulate over long sessions.
 */
 
 #include "ring_buffer.h"
 
 #include <string.h>
 
+static void ring_buffer_resync(ring_buffer_t *p_ring_buf);
+static void deque_expire(ring_buffer_deque_t *p_deque, size_t pos, size_t size);
+static void deque_push(ring_buffer_deque_t *p_deque, const float *p_buf, size_t pos,
+                       size_t size, bool is_max);
+
 int ring_buffer_init(ring_buffer_t *p_ring_buf, float *p_buf, size_t size)
 {
     if (p_ring_buf && p_buf)
     {
-        p_ring_buf->head = 0;
-        p_ring_buf->num_items = 0;
         p_ring_buf->size = size;
-        p_ring_buf->sum = 0.0f;
         p_ring_buf->p_buf = p_buf;
+        p_ring_buf->var_enabled = false;
+        memset(&p_ring_buf->min_deque, 0, sizeof(ring_buffer_deque_t));
+        memset(&p_ring_buf->max_deque, 0, sizeof(ring_buffer_deque_t));
 
         k_mutex_init(&p_ring_buf->mutex);
 
+        return ring_buffer_clear(p_ring_buf);
+    }
+
+    return -1;
+}
+
+// Empties the window. The buffer stays initialised, along with the variance
+// and min/max tracking enabled on it.
+int ring_buffer_clear(ring_buffer_t *p_ring_buf)
+{
+    if (p_ring_buf)
+    {
+        k_mutex_lock(&p_ring_buf->mutex, K_FOREVER);
+
+        p_ring_buf->head = 0;
+        p_ring_buf->num_items = 0;
+        p_ring_buf->sum = 0.0f;
+        p_ring_buf->mean = 0.0f;
+        p_ring_buf->m2 = 0.0f;
+        p_ring_buf->min_deque.first = 0;
+        p_ring_buf->min_deque.num = 0;
+        p_ring_buf->max_deque.first = 0;
+        p_ring_buf->max_deque.num = 0;
+
+        k_mutex_unlock(&p_ring_buf->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+// Must be called after init, before the first item is put
+int ring_buffer_enable_var(ring_buffer_t *p_ring_buf)
+{
+    if (p_ring_buf && (0 == p_ring_buf->num_items))
+    {
+        p_ring_buf->var_enabled = true;
+
+        return 0;
+    }
+
+    return -1;
+}
+
+// Must be called after init, before the first item is put. Each of the
+// position buffers holds size items, pass NULL to track only one extreme.
+int ring_buffer_enable_min_max(ring_buffer_t *p_ring_buf, size_t *p_min_pos, size_t *p_max_pos)
+{
+    if (p_ring_buf && (0 == p_ring_buf->num_items))
+    {
+        p_ring_buf->min_deque.p_pos = p_min_pos;
+        p_ring_buf->max_deque.p_pos = p_max_pos;
+
         return 0;
     }
 
@@ -28,7 +92,9 @@ int ring_buffer_init(ring_buffer_t *p_ring_buf, float *p_buf, size_t size)
 
 int ring_buffer_put(ring_buffer_t *p_ring_buf, float item)
 {
-    size_t tail;
+    float old_item;
+    float old_mean;
+    float delta;
 
     if (p_ring_buf && p_ring_buf->p_buf)
     {
@@ -38,15 +104,44 @@ int ring_buffer_put(ring_buffer_t *p_ring_buf, float item)
         {
             p_ring_buf->num_items += 1;
             p_ring_buf->sum += item;
+
+            if (p_ring_buf->var_enabled)
+            {
+                delta = item - p_ring_buf->mean;
+                p_ring_buf->mean += delta / p_ring_buf->num_items;
+                p_ring_buf->m2 += delta * (item - p_ring_buf->mean);
+            }
         }
         else
         {
-            p_ring_buf->sum = p_ring_buf->sum - p_ring_buf->p_buf[p_ring_buf->head] + item;
+            old_item = p_ring_buf->p_buf[p_ring_buf->head];
+
+            p_ring_buf->sum = p_ring_buf->sum - old_item + item;
+
+            if (p_ring_buf->var_enabled)
+            {
+                old_mean = p_ring_buf->mean;
+                p_ring_buf->mean += (item - old_item) / p_ring_buf->size;
+                p_ring_buf->m2 += (item - old_item) * (item - p_ring_buf->mean + old_item - old_mean);
+            }
+
+            // The item being overwritten is the oldest one
+            deque_expire(&p_ring_buf->min_deque, p_ring_buf->head, p_ring_buf->size);
+            deque_expire(&p_ring_buf->max_deque, p_ring_buf->head, p_ring_buf->size);
         }
         
         p_ring_buf->p_buf[p_ring_buf->head] = item;
+
+        deque_push(&p_ring_buf->min_deque, p_ring_buf->p_buf, p_ring_buf->head, p_ring_buf->size, false);
+        deque_push(&p_ring_buf->max_deque, p_ring_buf->p_buf, p_ring_buf->head, p_ring_buf->size, true);
+
         p_ring_buf->head = (p_ring_buf->head + 1) % p_ring_buf->size;
 
+        if ((0 == p_ring_buf->head) && (p_ring_buf->num_items == p_ring_buf->size))
+        {
+            ring_buffer_resync(p_ring_buf);
+        }
+
         k_mutex_unlock(&p_ring_buf->mutex);
 
         return 0;
@@ -78,6 +173,93 @@ int ring_buffer_mov_avg(ring_buffer_t *p_ring_buf, float *p_res)
     return -1;
 }
 
+// Sum of the items in the window, kept up to date on every put
+int ring_buffer_sum(ring_buffer_t *p_ring_buf, float *p_res)
+{
+    if (p_ring_buf && p_res)
+    {
+        k_mutex_lock(&p_ring_buf->mutex, K_FOREVER);
+        *p_res = p_ring_buf->sum;
+        k_mutex_unlock(&p_ring_buf->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+// Sample variance of the window, 0 with fewer than two items
+int ring_buffer_var(ring_buffer_t *p_ring_buf, float *p_res)
+{
+    if (p_ring_buf && p_ring_buf->var_enabled && p_res)
+    {
+        k_mutex_lock(&p_ring_buf->mutex, K_FOREVER);
+
+        if (p_ring_buf->num_items > 1)
+        {
+            // Rounding in the sliding update can leave m2 slightly below 0
+            // between resyncs, for example when all items are equal
+            *p_res = MAX(p_ring_buf->m2 / (p_ring_buf->num_items - 1), 0.0f);
+        }
+        else
+        {
+            *p_res = 0.0f;
+        }
+
+        k_mutex_unlock(&p_ring_buf->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+int ring_buffer_min(ring_buffer_t *p_ring_buf, float *p_res)
+{
+    if (p_ring_buf && p_ring_buf->min_deque.p_pos && p_res)
+    {
+        k_mutex_lock(&p_ring_buf->mutex, K_FOREVER);
+
+        if (p_ring_buf->min_deque.num != 0)
+        {
+            *p_res = p_ring_buf->p_buf[p_ring_buf->min_deque.p_pos[p_ring_buf->min_deque.first]];
+        }
+        else
+        {
+            *p_res = 0.0f;
+        }
+
+        k_mutex_unlock(&p_ring_buf->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+int ring_buffer_max(ring_buffer_t *p_ring_buf, float *p_res)
+{
+    if (p_ring_buf && p_ring_buf->max_deque.p_pos && p_res)
+    {
+        k_mutex_lock(&p_ring_buf->mutex, K_FOREVER);
+
+        if (p_ring_buf->max_deque.num != 0)
+        {
+            *p_res = p_ring_buf->p_buf[p_ring_buf->max_deque.p_pos[p_ring_buf->max_deque.first]];
+        }
+        else
+        {
+            *p_res = 0.0f;
+        }
+
+        k_mutex_unlock(&p_ring_buf->mutex);
+
+        return 0;
+    }
+
+    return -1;
+}
+
 int ring_buffer_copy_inorder(ring_buffer_t *p_ring_buf, float *p_dest)
 {
     if (p_ring_buf && p_ring_buf->p_buf && p_dest)
@@ -106,6 +288,46 @@ int ring_buffer_copy_inorder(ring_buffer_t *p_ring_buf, float *p_dest)
     return -1;
 }
 
+/**
+ * Hands the current window to the visitor in place, as one span while the
+ * buffer is filling up and as two spans once the head has circled around.
+ * Returns the number of items visited.
+*/
+int ring_buffer_visit(ring_buffer_t *p_ring_buf, ring_buffer_visitor_t visitor, void *p_ctx)
+{
+    int num_items;
+
+    if (p_ring_buf && p_ring_buf->p_buf && visitor)
+    {
+        k_mutex_lock(&p_ring_buf->mutex, K_FOREVER);
+
+        if (p_ring_buf->num_items < p_ring_buf->size)
+        {
+            if (p_ring_buf->head > 0)
+            {
+                visitor(p_ring_buf->p_buf, p_ring_buf->head, p_ctx);
+            }
+        }
+        else
+        {
+            visitor(&p_ring_buf->p_buf[p_ring_buf->head], p_ring_buf->size - p_ring_buf->head, p_ctx);
+
+            if (p_ring_buf->head > 0)
+            {
+                visitor(p_ring_buf->p_buf, p_ring_buf->head, p_ctx);
+            }
+        }
+
+        num_items = p_ring_buf->num_items;
+
+        k_mutex_unlock(&p_ring_buf->mutex);
+
+        return num_items;
+    }
+
+    return -1;
+}
+
 size_t ring_buffer_get_num_items(ring_buffer_t *p_ring_buf)
 {
     size_t num_items = 0;
@@ -121,3 +343,73 @@ size_t ring_buffer_get_num_items(ring_buffer_t *p_ring_buf)
 
     return num_items;
 }
+
+// Recomputes the running sums from the buffer contents. The mean and M2 are
+// computed in two passes, which is exact up to a single rounding per item.
+static void ring_buffer_resync(ring_buffer_t *p_ring_buf)
+{
+    float sum = 0.0f;
+    float m2 = 0.0f;
+    float mean;
+    float delta;
+
+    for (size_t i = 0; i < p_ring_buf->num_items; i++)
+    {
+        sum += p_ring_buf->p_buf[i];
+    }
+
+    p_ring_buf->sum = sum;
+
+    if (p_ring_buf->var_enabled)
+    {
+        mean = sum / p_ring_buf->num_items;
+
+        for (size_t i = 0; i < p_ring_buf->num_items; i++)
+        {
+            delta = p_ring_buf->p_buf[i] - mean;
+            m2 += delta * delta;
+        }
+
+        p_ring_buf->mean = mean;
+        p_ring_buf->m2 = m2;
+    }
+}
+
+// Drops the front position if it is about to be overwritten
+static void deque_expire(ring_buffer_deque_t *p_deque, size_t pos, size_t size)
+{
+    if (p_deque->p_pos && (p_deque->num != 0) && (p_deque->p_pos[p_deque->first] == pos))
+    {
+        p_deque->first = (p_deque->first + 1) % size;
+        p_deque->num--;
+    }
+}
+
+// Drops every position from the back that can no longer become the extreme
+// while the new item is in the window, then appends the new item
+static void deque_push(ring_buffer_deque_t *p_deque, const float *p_buf, size_t pos,
+                       size_t size, bool is_max)
+{
+    size_t back;
+
+    if (NULL == p_deque->p_pos)
+    {
+        return;
+    }
+
+    while (p_deque->num != 0)
+    {
+        back = (p_deque->first + p_deque->num - 1) % size;
+
+        if (is_max ? (p_buf[p_deque->p_pos[back]] > p_buf[pos])
+                   : (p_buf[p_deque->p_pos[back]] < p_buf[pos]))
+        {
+            break;
+        }
+
+        p_deque->num--;
+    }
+
+    p_deque->p_pos[(p_deque->first + p_deque->num) % size] = pos;
+    p_deque->num++;
+}
\ No newline at end of file
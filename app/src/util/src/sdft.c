@@ -0,0 +1,121 @@
+/**
+ * Sliding DFT over the last N points of a uniformly sampled series, tracking
+ * only a contiguous range of bins.
+ *
+ * Every push updates each tracked bin in O(1) from the new point and the one
+ * leaving the window, nothing is recomputed over the window. The recursion
+ * is damped slightly, so float rounding errors decay instead of building up.
+ *
+ * The caller provides the history of win_len floats and the bin array of
+ * SDFT_BINS_LEN(num_bins) floats. Instances are not locked, each one belongs
+ * to a single producer.
+*/
+
+#include "sdft.h"
+
+#include <string.h>
+#include <math.h>
+
+// Damping factor that keeps the recursive DFT stable against float rounding
+#define SDFT_DAMPING 0.9999f
+
+int sdft_init(sdft_t *p_sdft, float *p_hist, size_t win_len, float *p_bins,
+              size_t first_bin, size_t num_bins)
+{
+    float theta;
+
+    if (p_sdft && p_hist && p_bins && (win_len > 0) && (num_bins > 0))
+    {
+        p_sdft->win_len = win_len;
+        p_sdft->first_bin = first_bin;
+        p_sdft->num_bins = num_bins;
+        p_sdft->p_hist = p_hist;
+        p_sdft->p_bin_re = p_bins;
+        p_sdft->p_bin_im = &p_bins[num_bins];
+        p_sdft->p_twiddle_re = &p_bins[2 * num_bins];
+        p_sdft->p_twiddle_im = &p_bins[3 * num_bins];
+
+        for (size_t i = 0; i < num_bins; i++)
+        {
+            theta = 2.0f * (float) M_PI * (first_bin + i) / win_len;
+            p_sdft->p_twiddle_re[i] = SDFT_DAMPING * cosf(theta);
+            p_sdft->p_twiddle_im[i] = SDFT_DAMPING * sinf(theta);
+        }
+
+        p_sdft->damping_pow_n = powf(SDFT_DAMPING, win_len);
+
+        return sdft_clear(p_sdft);
+    }
+
+    return -1;
+}
+
+// Empties the window, the bins start again from zero
+int sdft_clear(sdft_t *p_sdft)
+{
+    if (p_sdft && p_sdft->p_hist)
+    {
+        memset(p_sdft->p_hist, 0, p_sdft->win_len * sizeof(float));
+        memset(p_sdft->p_bin_re, 0, p_sdft->num_bins * sizeof(float));
+        memset(p_sdft->p_bin_im, 0, p_sdft->num_bins * sizeof(float));
+        p_sdft->idx = 0;
+        p_sdft->num_items = 0;
+
+        return 0;
+    }
+
+    return -1;
+}
+
+int sdft_push(sdft_t *p_sdft, float x)
+{
+    float oldest = 0.0f;
+    float delta;
+    float re;
+    float im;
+
+    if (!p_sdft || !p_sdft->p_hist)
+    {
+        return -1;
+    }
+
+    if (p_sdft->num_items < p_sdft->win_len)
+    {
+        p_sdft->num_items++;
+    }
+    else
+    {
+        oldest = p_sdft->p_hist[p_sdft->idx];
+    }
+
+    p_sdft->p_hist[p_sdft->idx] = x;
+    p_sdft->idx = (p_sdft->idx + 1) % p_sdft->win_len;
+
+    // X_k(n) = r * e^(j*2*pi*k/N) * (X_k(n-1) + x(n) - r^N * x(n-N))
+    delta = x - p_sdft->damping_pow_n * oldest;
+
+    for (size_t i = 0; i < p_sdft->num_bins; i++)
+    {
+        re = p_sdft->p_bin_re[i] + delta;
+        im = p_sdft->p_bin_im[i];
+        p_sdft->p_bin_re[i] = re * p_sdft->p_twiddle_re[i] - im * p_sdft->p_twiddle_im[i];
+        p_sdft->p_bin_im[i] = re * p_sdft->p_twiddle_im[i] + im * p_sdft->p_twiddle_re[i];
+    }
+
+    return 0;
+}
+
+// The bins only hold the spectrum of the window once it is filled
+bool sdft_is_full(const sdft_t *p_sdft)
+{
+    return p_sdft && (p_sdft->num_items == p_sdft->win_len);
+}
+
+// Squared magnitude of DFT bin k, which has to be one of the tracked bins
+float sdft_power(const sdft_t *p_sdft, size_t bin)
+{
+    size_t i = bin - p_sdft->first_bin;
+
+    return p_sdft->p_bin_re[i] * p_sdft->p_bin_re[i] +
+           p_sdft->p_bin_im[i] * p_sdft->p_bin_im[i];
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+/**
+ * Shared timebase of the sampled streams.
+ *
+ * All timestamps of samples and events are microseconds of one monotonic
+ * counter, the kernel uptime. Within a stream, the time of a sample follows
+ * from its position in the stream, so timestamps are as exact as the
+ * sample clock and stay evenly spaced. The sampling thread anchors that to
+ * the counter with timebase_clock_sync() after reading, which also follows
+ * a sensor oscillator that drifts against the CPU clock.
+ *
+ * Filter and decimation delays are compensated by the processing cores,
+ * which move the sample position back by the delay before converting it.
+ * Without syncs, as in the host replay, sample 0 is at 0 us.
+*/
+
+#include "timebase.h"
+
+#include <zephyr/kernel.h>
+
+int64_t timebase_now_us(void)
+{
+    return (int64_t) k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+int timebase_clock_init(timebase_clock_t *p_clock, uint32_t period_us)
+{
+    if (!p_clock || (0 == period_us))
+    {
+        return -1;
+    }
+
+    p_clock->origin_us = 0;
+    p_clock->period_us = period_us;
+    p_clock->synced = false;
+
+    return 0;
+}
+
+// Anchors the stream at now_us, when num_samples samples have been read. The
+// last of them was taken within one period before. The first sync assumes
+// the middle of that period, later ones only move the anchor as far as
+// needed to keep the last sample within the period.
+void timebase_clock_sync(timebase_clock_t *p_clock, uint64_t num_samples, int64_t now_us)
+{
+    int64_t last_us = p_clock->origin_us + (int64_t) num_samples * p_clock->period_us;
+
+    if (!p_clock->synced)
+    {
+        p_clock->origin_us += now_us - p_clock->period_us / 2 - last_us;
+        p_clock->synced = true;
+    }
+    else if (last_us > now_us)
+    {
+        p_clock->origin_us -= last_us - now_us;
+    }
+    else if (last_us < now_us - p_clock->period_us)
+    {
+        p_clock->origin_us += now_us - p_clock->period_us - last_us;
+    }
+}
+
+// Time of a sample position with frac_bits fractional bits
+int64_t timebase_clock_get_us(const timebase_clock_t *p_clock, int64_t sample_q, uint8_t frac_bits)
+{
+    return p_clock->origin_us + ((sample_q * p_clock->period_us) >> frac_bits);
+}
\ No newline at end of file
@@ -1,29 +1,148 @@
-#define DT_DRV_COMPAT maxim_max30100
-
 #include "max30100.h"
 
 #include <zephyr/logging/log.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/pm/device_runtime.h>
 
 LOG_MODULE_REGISTER(MAX30100, CONFIG_SENSOR_LOG_LEVEL);
 
+static const struct max3010x_regs max3010x_regs[] = {
+	[MAX3010X_VARIANT_MAX30100] = {
+		.fifo_wr = MAX30100_REG_FIFO_WR,
+		.fifo_data = MAX30100_REG_FIFO_DATA,
+		.mode_cfg = MAX30100_REG_MODE_CFG,
+		.part_id = MAX30100_PART_ID,
+		.fifo_depth = MAX30100_FIFO_DEPTH,
+		.bytes_per_led = MAX30100_BYTES_PER_LED,
+	},
+	[MAX3010X_VARIANT_MAX30102] = {
+		.fifo_wr = MAX30102_REG_FIFO_WR,
+		.fifo_data = MAX30102_REG_FIFO_DATA,
+		.mode_cfg = MAX30102_REG_MODE_CFG,
+		.part_id = MAX30102_PART_ID,
+		.fifo_depth = MAX30102_FIFO_DEPTH,
+		.bytes_per_led = MAX30102_BYTES_PER_LED,
+	},
+};
+
+/*
+ * Reads every sample waiting in the FIFO with a single burst, so a wakeup
+ * costs two bus transactions no matter how many samples piled up
+ */
+static int max30100_fifo_burst(const struct device *dev)
+{
+	const struct max30100_config *config = dev->config;
+	const struct max3010x_regs *regs = &max3010x_regs[config->variant];
+	struct max30100_data *data = dev->data;
+	uint8_t status[MAX30102_REG_FIFO_RD + 1];
+	const uint8_t *ptr = &status[regs->fifo_wr];
+	uint8_t num_samples;
+
+	/*
+	 * The interrupt status comes first in the register map, then the
+	 * write pointer, overflow counter and read pointer. Reading the status
+	 * clears it.
+	 */
+	if (i2c_burst_read_dt(&config->i2c, MAX30100_REG_INT_STAT, status,
+			      regs->fifo_wr + 3)) {
+		LOG_ERR("Could not read FIFO pointers");
+		return -EIO;
+	}
+
+	/*
+	 * The pointers are equal both when the FIFO is empty and when it is
+	 * full. They mean full after an overflow, or if the FIFO got almost
+	 * full since the last burst, as it cannot have been emptied since.
+	 */
+	num_samples = (ptr[0] - ptr[2]) & (regs->fifo_depth - 1);
+	if ((0 == num_samples) && (ptr[1] || (status[0] & MAX3010X_INT_A_FULL))) {
+		num_samples = regs->fifo_depth;
+	}
+
+	data->num_buffered = 0;
+	data->next = 0;
+	data->num_ovf = ptr[1];
+
+	if (0 == num_samples) {
+		return -ENODATA;
+	}
+
+	if (i2c_burst_read_dt(&config->i2c, regs->fifo_data, data->fifo_buf,
+			      num_samples * config->num_slots * regs->bytes_per_led)) {
+		LOG_ERR("Could not fetch samples");
+		return -EIO;
+	}
+
+	data->num_buffered = num_samples;
+
+	return 0;
+}
+
+/*
+ * Hands out one sample per call from the samples read in the last burst, and
+ * bursts again once they are used up. Returns -ENODATA if the FIFO is empty.
+ */
 static int max30100_sample_fetch(const struct device *dev,
 				 enum sensor_channel chan)
 {
 	const struct max30100_config *config = dev->config;
+	const struct max3010x_regs *regs = &max3010x_regs[config->variant];
 	struct max30100_data *data = dev->data;
+	const uint8_t *sample;
+	uint32_t value;
+	int ret;
 
-	uint8_t buffer[MAX30100_BYTES_PER_SAMPLE];
+	if (data->next >= data->num_buffered) {
+		ret = max30100_fifo_burst(dev);
+		if (ret) {
+			return ret;
+		}
+	}
 
-	if (i2c_burst_read_dt(&config->i2c, MAX30100_REG_FIFO_DATA, buffer,
-			      MAX30100_BYTES_PER_SAMPLE)) {
-		LOG_ERR("Could not fetch sample");
-		return -EIO;
+	/*
+	 * A full FIFO drops the newest samples, so the overflow is reported
+	 * with the last sample of the burst. With rollover it overwrites the
+	 * oldest ones instead, and it is reported with the first sample.
+	 */
+	if (config->fifo & MAX30102_FIFO_CFG_ROLLOVER_EN) {
+		data->lost = (0 == data->next) ? data->num_ovf : 0;
+	} else {
+		data->lost = (data->next + 1 == data->num_buffered) ? data->num_ovf : 0;
+	}
+
+	sample = &data->fifo_buf[data->next * config->num_slots * regs->bytes_per_led];
+
+	for (uint8_t i = 0; i < config->num_slots; i++) {
+		if (MAX30102_BYTES_PER_LED == regs->bytes_per_led) {
+			value = ((uint32_t) sample[0] << 16) |
+				((uint32_t) sample[1] << 8) | sample[2];
+			value &= MAX30102_SAMPLE_MASK;
+		} else {
+			value = ((uint32_t) sample[0] << 8) | sample[1];
+		}
+
+		if (config->slot[i] != MAX3010X_LED_NONE) {
+			data->led[config->slot[i] - 1] = value;
+		}
+
+		sample += regs->bytes_per_led;
 	}
 
-	data->ir = ((uint16_t) buffer[0] << 8) | buffer[1];
-	data->red = ((uint16_t) buffer[2] << 8) | buffer[3];
+	data->next++;
 
-    return 0;
+	return 0;
+}
+
+static bool max30100_led_enabled(const struct max30100_config *config,
+				 enum max3010x_led led)
+{
+	for (uint8_t i = 0; i < config->num_slots; i++) {
+		if (config->slot[i] == led) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 static int max30100_channel_get(const struct device *dev,
@@ -32,115 +151,341 @@ static int max30100_channel_get(const struct device *dev,
 {
 	const struct max30100_config *config = dev->config;
 	struct max30100_data *data = dev->data;
+	enum max3010x_led led;
+
+	val->val2 = 0;
 
-	switch(chan)
-	{
-		case SENSOR_CHAN_RED:
-			val->val1 = data->red;
-			val->val2 = 0;
+	switch ((int) chan) {
+	case SENSOR_CHAN_RED:
+		led = MAX3010X_LED_RED;
 		break;
 
-		case SENSOR_CHAN_IR:
-			if (MAX30100_MODE_SPO2 == config->mode)
-			{
-				val->val1 = data->ir;
-				val->val2 = 0;
-			}
-			else
-			{
-				LOG_ERR("Attempted to read IR channel but device is not in Sp02 mode");
-				return -ENOTSUP;
-			}
+	case SENSOR_CHAN_IR:
+		led = MAX3010X_LED_IR;
 		break;
 
-		default:
-			LOG_ERR("Channel not supported");
-			return -ENOTSUP;
+	case SENSOR_CHAN_GREEN:
+		led = MAX3010X_LED_GREEN;
 		break;
+
+	case SENSOR_CHAN_MAX3010X_PENDING:
+		val->val1 = data->num_buffered - data->next;
+		return 0;
+
+	case SENSOR_CHAN_MAX3010X_LOST:
+		val->val1 = data->lost;
+		return 0;
+
+	default:
+		LOG_ERR("Channel not supported");
+		return -ENOTSUP;
+	}
+
+	if (!max30100_led_enabled(config, led)) {
+		LOG_ERR("Attempted to read channel %d but its LED is not enabled", chan);
+		return -ENOTSUP;
+	}
+
+	val->val1 = data->led[led - 1];
+
+	return 0;
+}
+
+static int max30100_configure(const struct device *dev)
+{
+	const struct max30100_config *config = dev->config;
+
+	/* Write the mode configuration register */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_MODE_CFG,
+				  config->mode)) {
+		return -EIO;
+	}
+
+	/* Write the SpO2 configuration register */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_SPO2_CFG,
+				  config->spo2)) {
+		return -EIO;
+	}
+
+	/* Write the LED configuration register */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_LED_CFG,
+				  config->led)) {
+		return -EIO;
+	}
+
+	/* The almost full flag tells a full FIFO from an empty one */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_INT_EN,
+				  MAX3010X_INT_A_FULL)) {
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int max30102_configure(const struct device *dev)
+{
+	const struct max30100_config *config = dev->config;
+	uint8_t multi_led;
+
+	/*
+	 * Write the FIFO configuration register. The almost full threshold is
+	 * left at 0, so the flag is raised when the FIFO is full.
+	 */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_FIFO_CFG,
+				  config->fifo)) {
+		return -EIO;
+	}
+
+	/* The almost full flag tells a full FIFO from an empty one */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_INT_EN1,
+				  MAX3010X_INT_A_FULL)) {
+		return -EIO;
+	}
+
+	/* Write the mode configuration register */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_MODE_CFG,
+				  config->mode)) {
+		return -EIO;
+	}
+
+	/* Write the SpO2 configuration register */
+	if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_SPO2_CFG,
+				  config->spo2)) {
+		return -EIO;
+	}
+
+	/* Write the LED pulse amplitude registers */
+	for (uint8_t i = 0; i < MAX30102_NUM_LEDS; i++) {
+		if (i2c_reg_write_byte_dt(&config->i2c, MAX30102_REG_LED1_PA + i,
+					  config->led_pa[i])) {
+			return -EIO;
+		}
+	}
+
+	if (MAX30102_MODE_MULTI_LED != config->mode) {
+		return 0;
+	}
+
+	/* Write the multi-LED slot registers, two slots per register */
+	for (uint8_t i = 0; i < MAX3010X_MAX_SLOTS; i += 2) {
+		multi_led = config->slot[i] |
+			    (config->slot[i + 1] << MAX30102_MULTI_LED_SLOT_SHIFT);
+
+		if (i2c_reg_write_byte_dt(&config->i2c,
+					  MAX30102_REG_MULTI_LED + (i / 2),
+					  multi_led)) {
+			return -EIO;
+		}
 	}
 
-    return 0;
+	return 0;
 }
 
 static int max30100_init(const struct device *dev)
 {
-    const struct max30100_config *config = dev->config;
-    struct max30100_data *data = dev->data;
-    uint8_t part_id;
-    uint8_t mode_cfg;
+	const struct max30100_config *config = dev->config;
+	const struct max3010x_regs *regs = &max3010x_regs[config->variant];
+	uint8_t part_id;
+	uint8_t mode_cfg;
+	int ret;
 
-    if (!device_is_ready(config->i2c.bus)) {
+	if (!device_is_ready(config->i2c.bus)) {
 		LOG_ERR("Bus device is not ready");
 		return -ENODEV;
 	}
 
-    /* Check the part id to make sure this is MAX30101 */
+	/* Check the part id to make sure this is the configured variant */
 	if (i2c_reg_read_byte_dt(&config->i2c, MAX30100_REG_PART_ID,
 				 &part_id)) {
 		LOG_ERR("Could not get Part ID");
 		return -EIO;
 	}
 
-    if (part_id != MAX30100_PART_ID) {
+	if (part_id != regs->part_id) {
 		LOG_ERR("Got Part ID 0x%02x, expected 0x%02x",
-			    part_id, MAX30100_PART_ID);
+			part_id, regs->part_id);
 		return -EIO;
 	}
 
-    /* Reset the sensor */
-	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_MODE_CFG,
+	/* Reset the sensor */
+	if (i2c_reg_write_byte_dt(&config->i2c, regs->mode_cfg,
 				  MAX30100_MODE_CFG_RESET_MASK)) {
 		return -EIO;
 	}
 
-    /* Wait for reset to be cleared */
+	/* Wait for reset to be cleared */
 	do {
-		if (i2c_reg_read_byte_dt(&config->i2c, MAX30100_REG_MODE_CFG,
+		if (i2c_reg_read_byte_dt(&config->i2c, regs->mode_cfg,
 					 &mode_cfg)) {
 			LOG_ERR("Could not read mode cfg after reset");
 			return -EIO;
 		}
 	} while (mode_cfg & MAX30100_MODE_CFG_RESET_MASK);
 
-    /* Write the mode configuration register */
-	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_MODE_CFG,
-				  config->mode)) {
-		return -EIO;
+	if (MAX3010X_VARIANT_MAX30102 == config->variant) {
+		ret = max30102_configure(dev);
+	} else {
+		ret = max30100_configure(dev);
 	}
 
-    /* Write the SpO2 configuration register */
-	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_SPO2_CFG,
-				  config->spo2)) {
-		return -EIO;
+	if (ret) {
+		return ret;
 	}
 
-	/* Write the LED configuration register */
-	if (i2c_reg_write_byte_dt(&config->i2c, MAX30100_REG_LED_CFG,
-				  config->led)) {
+	LOG_DBG("Successful init");
+
+#if defined(CONFIG_PM_DEVICE_RUNTIME)
+	/* Keep the LEDs off until the first user resumes the device */
+	if (i2c_reg_update_byte_dt(&config->i2c, regs->mode_cfg,
+				   MAX30100_MODE_CFG_SHDN_MASK,
+				   MAX30100_MODE_CFG_SHDN_MASK)) {
 		return -EIO;
 	}
 
-    LOG_DBG("Successful init");
+	pm_device_init_suspended(dev);
 
-    return 0;
+	return pm_device_runtime_enable(dev);
+#else
+	return 0;
+#endif
 }
 
+#if defined(CONFIG_PM_DEVICE)
+static int max30100_pm_action(const struct device *dev,
+			      enum pm_device_action action)
+{
+	const struct max30100_config *config = dev->config;
+	const struct max3010x_regs *regs = &max3010x_regs[config->variant];
+	struct max30100_data *data = dev->data;
+	const uint8_t zero[3] = { 0 };
+	uint8_t status;
+
+	switch (action) {
+	case PM_DEVICE_ACTION_SUSPEND:
+		/* Shutdown mode turns the LEDs off, register contents are kept */
+		if (i2c_reg_update_byte_dt(&config->i2c, regs->mode_cfg,
+					   MAX30100_MODE_CFG_SHDN_MASK,
+					   MAX30100_MODE_CFG_SHDN_MASK)) {
+			return -EIO;
+		}
+		break;
+
+	case PM_DEVICE_ACTION_RESUME:
+		if (i2c_reg_update_byte_dt(&config->i2c, regs->mode_cfg,
+					   MAX30100_MODE_CFG_SHDN_MASK, 0)) {
+			return -EIO;
+		}
+
+		/* Drop the samples left over from before the shutdown */
+		if (i2c_burst_write_dt(&config->i2c, regs->fifo_wr, zero,
+				       sizeof(zero))) {
+			return -EIO;
+		}
+
+		/* and a stale almost full flag, which would mark it full */
+		if (i2c_reg_read_byte_dt(&config->i2c, MAX30100_REG_INT_STAT,
+					 &status)) {
+			return -EIO;
+		}
+
+		data->num_buffered = 0;
+		data->next = 0;
+		data->num_ovf = 0;
+		data->lost = 0;
+		break;
+
+	default:
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+#endif /* CONFIG_PM_DEVICE */
+
 static const struct sensor_driver_api max30100_driver_api = {
 	.sample_fetch = max30100_sample_fetch,
 	.channel_get = max30100_channel_get,
 };
 
-static const struct max30100_config max30100_config = {
-    .i2c = I2C_DT_SPEC_INST_GET(0),
-    .mode = MAX30100_MODE_SPO2,
-    .spo2 = MAX30100_SPO2_CFG_SR
-            | MAX30100_SPO2_CFG_LED_PW,
-    .led = MAX30100_LED_CFG_IR | MAX30100_LED_CFG_RED,
-};
+#define MAX30100_DEVICE_DEFINE(inst, name)					\
+	static struct max30100_data name##_data_##inst;			\
+										\
+	PM_DEVICE_DT_INST_DEFINE(inst, max30100_pm_action);			\
+										\
+	SENSOR_DEVICE_DT_INST_DEFINE(inst, max30100_init,			\
+				     PM_DEVICE_DT_INST_GET(inst),		\
+				     &name##_data_##inst,			\
+				     &name##_config_##inst,			\
+				     POST_KERNEL,				\
+				     CONFIG_SENSOR_INIT_PRIORITY,		\
+				     &max30100_driver_api);
+
+#define DT_DRV_COMPAT maxim_max30100
+
+#define MAX30100_DEFINE(inst)							\
+	static const struct max30100_config max30100_config_##inst = {		\
+		.i2c = I2C_DT_SPEC_INST_GET(inst),				\
+		.variant = MAX3010X_VARIANT_MAX30100,				\
+		.mode = MAX30100_MODE_SPO2,					\
+		.spo2 = MAX30100_SPO2_CFG_SR | MAX30100_SPO2_CFG_LED_PW,	\
+		.led = MAX30100_LED_CFG_IR | MAX30100_LED_CFG_RED,		\
+		.slot = { MAX3010X_LED_IR, MAX3010X_LED_RED },			\
+		.num_slots = 2,							\
+	};									\
+										\
+	MAX30100_DEVICE_DEFINE(inst, max30100)
+
+DT_INST_FOREACH_STATUS_OKAY(MAX30100_DEFINE)
+
+#undef DT_DRV_COMPAT
+#define DT_DRV_COMPAT maxim_max30102
+
+/* In multi-LED mode the slots come from the devicetree, the other modes
+ * have a fixed layout: red only for heart rate, red then IR for SpO2
+ */
+#define MAX30102_SLOT(inst, n, fixed)						\
+	((MAX30102_MODE_MULTI_LED == DT_INST_PROP(inst, mode)) ?		\
+	 DT_INST_PROP(inst, led_slot##n) : (fixed))
+
+#define MAX30102_NUM_SLOTS(inst)						\
+	((MAX30102_MODE_MULTI_LED == DT_INST_PROP(inst, mode)) ?		\
+	 ((DT_INST_PROP(inst, led_slot1) != 0) +				\
+	  (DT_INST_PROP(inst, led_slot2) != 0) +				\
+	  (DT_INST_PROP(inst, led_slot3) != 0) +				\
+	  (DT_INST_PROP(inst, led_slot4) != 0)) :				\
+	 ((MAX30100_MODE_SPO2 == DT_INST_PROP(inst, mode)) ? 2 : 1))
 
-static struct max30100_data max30100_data;
+#define MAX30102_DEFINE(inst)							\
+	static const struct max30100_config max30102_config_##inst = {		\
+		.i2c = I2C_DT_SPEC_INST_GET(inst),				\
+		.variant = MAX3010X_VARIANT_MAX30102,				\
+		.mode = DT_INST_PROP(inst, mode),				\
+		.fifo = (DT_INST_ENUM_IDX(inst, smp_ave) <<			\
+			 MAX30102_FIFO_CFG_SMP_AVE_SHIFT) |			\
+			(DT_INST_PROP(inst, fifo_rollover_en) ?			\
+			 MAX30102_FIFO_CFG_ROLLOVER_EN : 0),			\
+		.spo2 = (DT_INST_ENUM_IDX(inst, adc_rge) <<			\
+			 MAX30102_SPO2_CFG_ADC_RGE_SHIFT) |			\
+			(DT_INST_ENUM_IDX(inst, smp_sr) <<			\
+			 MAX30102_SPO2_CFG_SR_SHIFT) |				\
+			DT_INST_ENUM_IDX(inst, led_pw),				\
+		.led_pa = {							\
+			DT_INST_PROP(inst, led1_pa),				\
+			DT_INST_PROP(inst, led2_pa),				\
+			DT_INST_PROP(inst, led3_pa),				\
+		},								\
+		.slot = {							\
+			MAX30102_SLOT(inst, 1, MAX3010X_LED_RED),		\
+			MAX30102_SLOT(inst, 2,					\
+				      (MAX30100_MODE_SPO2 ==			\
+				       DT_INST_PROP(inst, mode)) ?		\
+				      MAX3010X_LED_IR : MAX3010X_LED_NONE),	\
+			MAX30102_SLOT(inst, 3, MAX3010X_LED_NONE),		\
+			MAX30102_SLOT(inst, 4, MAX3010X_LED_NONE),		\
+		},								\
+		.num_slots = MAX30102_NUM_SLOTS(inst),				\
+	};									\
+										\
+	MAX30100_DEVICE_DEFINE(inst, max30102)
 
-SENSOR_DEVICE_DT_INST_DEFINE(0, max30100_init, NULL,
-		    &max30100_data, &max30100_config,
-		    POST_KERNEL, CONFIG_SENSOR_INIT_PRIORITY,
-		    &max30100_driver_api);
\ No newline at end of file
+DT_INST_FOREACH_STATUS_OKAY(MAX30102_DEFINE)
\ No newline at end of file
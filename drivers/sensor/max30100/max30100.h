@@ -2,10 +2,12 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/sys/util.h>
 
+#include <drivers/sensor/max3010x.h>
+
 #define MAX30100_REG_INT_STAT   0x00
 #define MAX30100_REG_INT_EN     0x01
 
-#define MAX30100_REG FIFO_WR    0x02
+#define MAX30100_REG_FIFO_WR    0x02
 #define MAX30100_REG_FIFO_OVF   0x03
 #define MAX30100_REG_FIFO_RD    0x04
 #define MAX30100_REG_FIFO_DATA  0x05
@@ -18,6 +20,10 @@
 
 #define MAX30100_PART_ID        0x11
 
+/* Same bit in the interrupt status and enable registers of all variants */
+#define MAX3010X_INT_A_FULL     BIT(7)
+
+#define MAX30100_MODE_CFG_SHDN_MASK     BIT(7)
 #define MAX30100_MODE_CFG_RESET_MASK    BIT(6)
 
 #define MAX30100_SPO2_CFG_HI_RES_EN BIT(6)
@@ -27,21 +33,89 @@
 #define MAX30100_LED_CFG_IR     0x6
 #define MAX30100_LED_CFG_RED    (0x6 << 4)
 
-#define MAX30100_BYTES_PER_SAMPLE   4
+#define MAX30100_BYTES_PER_LED  2
+#define MAX30100_FIFO_DEPTH     16
+
+/* MAX30101 and MAX30102, same register map and part ID */
+#define MAX30102_REG_INT_EN1    0x02
+#define MAX30102_REG_FIFO_WR    0x04
+#define MAX30102_REG_FIFO_OVF   0x05
+#define MAX30102_REG_FIFO_RD    0x06
+#define MAX30102_REG_FIFO_DATA  0x07
+#define MAX30102_REG_FIFO_CFG   0x08
+
+#define MAX30102_REG_MODE_CFG   0x09
+#define MAX30102_REG_SPO2_CFG   0x0A
+#define MAX30102_REG_LED1_PA    0x0C
+#define MAX30102_REG_MULTI_LED  0x11
+
+#define MAX30102_PART_ID        0x15
+
+#define MAX30102_FIFO_CFG_SMP_AVE_SHIFT 5
+#define MAX30102_FIFO_CFG_ROLLOVER_EN   BIT(4)
+
+#define MAX30102_SPO2_CFG_ADC_RGE_SHIFT 5
+#define MAX30102_SPO2_CFG_SR_SHIFT      2
+
+#define MAX30102_MULTI_LED_SLOT_SHIFT   4
+
+#define MAX30102_BYTES_PER_LED  3
+#define MAX30102_FIFO_DEPTH     32
+#define MAX30102_SAMPLE_MASK    0x3FFFF
+#define MAX30102_NUM_LEDS       3
+
+#define MAX3010X_MAX_SLOTS      4
+
+/* Room for a full MAX30102 FIFO with every slot enabled */
+#define MAX3010X_FIFO_BUF_LEN \
+	(MAX30102_FIFO_DEPTH * MAX3010X_MAX_SLOTS * MAX30102_BYTES_PER_LED)
 
 enum max30100_mode {
 	MAX30100_MODE_HEART_RATE    = 2,
 	MAX30100_MODE_SPO2		    = 3,
+	MAX30102_MODE_MULTI_LED     = 7,
+};
+
+enum max3010x_variant {
+	MAX3010X_VARIANT_MAX30100,
+	MAX3010X_VARIANT_MAX30102,
+};
+
+/* LED driven in a time slot, the values match the MAX30101 slot encoding */
+enum max3010x_led {
+	MAX3010X_LED_NONE   = 0,
+	MAX3010X_LED_RED    = 1,
+	MAX3010X_LED_IR     = 2,
+	MAX3010X_LED_GREEN  = 3,
+};
+
+/* Registers and FIFO layout that differ between the variants */
+struct max3010x_regs {
+	uint8_t fifo_wr;
+	uint8_t fifo_data;
+	uint8_t mode_cfg;
+	uint8_t part_id;
+	uint8_t fifo_depth;
+	uint8_t bytes_per_led;
 };
 
 struct max30100_config {
     struct i2c_dt_spec i2c;
+    enum max3010x_variant variant;
     enum max30100_mode mode;
     uint8_t spo2;
-    uint8_t led;
+    uint8_t led;                            /* MAX30100 only */
+    uint8_t fifo;                           /* MAX30102 only */
+    uint8_t led_pa[MAX30102_NUM_LEDS];      /* MAX30102 only */
+    uint8_t slot[MAX3010X_MAX_SLOTS];
+    uint8_t num_slots;
 };
 
 struct max30100_data {
-    uint16_t red;
-    uint16_t ir;
+    uint32_t led[MAX30102_NUM_LEDS];
+    uint8_t fifo_buf[MAX3010X_FIFO_BUF_LEN];
+    uint8_t num_buffered;
+    uint8_t next;
+    uint8_t num_ovf;                        /* Overflow count of the burst */
+    uint8_t lost;                           /* Reported with the fetched sample */
 };
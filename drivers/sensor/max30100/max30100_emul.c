@@ -0,0 +1,283 @@
+/*
+ * I2C emulator of the MAX30100, for running the application on boards
+ * without the sensor, such as the BabbleSim ones.
+ *
+ * While the sensor is out of shutdown, samples are generated from the uptime
+ * at the configured sample rate. They go through a FIFO that behaves like the
+ * one of the real part: once it is full, new samples are dropped and counted
+ * in the overflow register. The almost full flag is raised with one free
+ * space left and cleared when the interrupt status is read.
+ */
+
+#define DT_DRV_COMPAT maxim_max30100
+
+#include "max30100.h"
+
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <drivers/sensor/max30100_emul.h>
+
+LOG_MODULE_REGISTER(MAX30100_EMUL, CONFIG_SENSOR_LOG_LEVEL);
+
+#define MAX30100_REG_REV_ID		0xFE
+#define MAX30100_REV_ID			0x03
+
+#define MAX30100_MODE_CFG_MODE_MASK	0x07
+#define MAX30100_SPO2_CFG_SR_SHIFT	2
+#define MAX30100_SPO2_CFG_SR_MASK	0x07
+
+#define MAX30100_FIFO_PTR_MASK		(MAX30100_FIFO_DEPTH - 1)
+#define MAX30100_OVF_MAX		0x0F
+
+/* IR then red, in every mode */
+#define MAX30100_SAMPLE_LEN		(2 * MAX30100_BYTES_PER_LED)
+
+/* Samples per second by the SPO2_SR field */
+static const uint16_t max30100_emul_rates[] = {
+	50, 100, 167, 200, 400, 600, 800, 1000,
+};
+
+struct max30100_emul_data {
+	uint8_t regs[256];
+	uint8_t fifo[MAX30100_FIFO_DEPTH][MAX30100_SAMPLE_LEN];
+	uint8_t num_stored;
+	/* Bytes of the oldest sample already read */
+	uint8_t byte_idx;
+	/* Time the sensor left shutdown and samples generated since */
+	int64_t start_ms;
+	uint32_t num_generated;
+	max30100_emul_signal_t signal;
+	void *user_data;
+};
+
+static bool max30100_emul_running(const struct max30100_emul_data *data)
+{
+	uint8_t mode_cfg = data->regs[MAX30100_REG_MODE_CFG];
+
+	return !(mode_cfg & MAX30100_MODE_CFG_SHDN_MASK) &&
+	       ((mode_cfg & MAX30100_MODE_CFG_MODE_MASK) != 0);
+}
+
+static void max30100_emul_reset(struct max30100_emul_data *data)
+{
+	memset(data->regs, 0, sizeof(data->regs));
+	data->regs[MAX30100_REG_REV_ID] = MAX30100_REV_ID;
+	data->regs[MAX30100_REG_PART_ID] = MAX30100_PART_ID;
+	data->num_stored = 0;
+	data->byte_idx = 0;
+	data->num_generated = 0;
+}
+
+static void max30100_emul_push(const struct emul *target)
+{
+	struct max30100_emul_data *data = target->data;
+	uint8_t mode = data->regs[MAX30100_REG_MODE_CFG] &
+		       MAX30100_MODE_CFG_MODE_MASK;
+	uint8_t wr = data->regs[MAX30100_REG_FIFO_WR];
+	uint8_t *sample = data->fifo[wr];
+	uint16_t ir = 0;
+	uint16_t red = 0;
+
+	if (data->signal) {
+		data->signal(target, data->num_generated, &ir, &red,
+			     data->user_data);
+	}
+	data->num_generated++;
+
+	if (data->num_stored == MAX30100_FIFO_DEPTH) {
+		if (data->regs[MAX30100_REG_FIFO_OVF] < MAX30100_OVF_MAX) {
+			data->regs[MAX30100_REG_FIFO_OVF]++;
+		}
+		return;
+	}
+
+	/* The red LED is off in heart rate mode */
+	if (MAX30100_MODE_HEART_RATE == mode) {
+		red = 0;
+	}
+
+	sys_put_be16(ir, &sample[0]);
+	sys_put_be16(red, &sample[MAX30100_BYTES_PER_LED]);
+
+	data->regs[MAX30100_REG_FIFO_WR] = (wr + 1) & MAX30100_FIFO_PTR_MASK;
+	data->num_stored++;
+
+	if ((MAX30100_FIFO_DEPTH - 1 == data->num_stored) &&
+	    (data->regs[MAX30100_REG_INT_EN] & MAX3010X_INT_A_FULL)) {
+		data->regs[MAX30100_REG_INT_STAT] |= MAX3010X_INT_A_FULL;
+	}
+}
+
+/* Generates the samples that came due since the last bus transfer */
+static void max30100_emul_update(const struct emul *target)
+{
+	struct max30100_emul_data *data = target->data;
+	uint8_t sr;
+	uint32_t num_due;
+
+	if (!max30100_emul_running(data)) {
+		return;
+	}
+
+	sr = (data->regs[MAX30100_REG_SPO2_CFG] >> MAX30100_SPO2_CFG_SR_SHIFT) &
+	     MAX30100_SPO2_CFG_SR_MASK;
+	num_due = (uint32_t) (((k_uptime_get() - data->start_ms) *
+			       max30100_emul_rates[sr]) / MSEC_PER_SEC);
+
+	while (data->num_generated < num_due) {
+		max30100_emul_push(target);
+	}
+}
+
+static uint8_t max30100_emul_pop(struct max30100_emul_data *data)
+{
+	uint8_t rd = data->regs[MAX30100_REG_FIFO_RD];
+	uint8_t value;
+
+	if (0 == data->num_stored) {
+		return 0;
+	}
+
+	value = data->fifo[rd][data->byte_idx++];
+
+	if (MAX30100_SAMPLE_LEN == data->byte_idx) {
+		data->byte_idx = 0;
+		data->regs[MAX30100_REG_FIFO_RD] = (rd + 1) & MAX30100_FIFO_PTR_MASK;
+		data->regs[MAX30100_REG_FIFO_OVF] = 0;
+		data->num_stored--;
+	}
+
+	return value;
+}
+
+static void max30100_emul_write(const struct emul *target, uint8_t reg,
+				uint8_t value)
+{
+	struct max30100_emul_data *data = target->data;
+	bool was_running = max30100_emul_running(data);
+
+	switch (reg) {
+	case MAX30100_REG_MODE_CFG:
+		if (value & MAX30100_MODE_CFG_RESET_MASK) {
+			/* The reset bit clears itself */
+			max30100_emul_reset(data);
+			return;
+		}
+
+		data->regs[reg] = value;
+
+		if (!was_running && max30100_emul_running(data)) {
+			data->start_ms = k_uptime_get();
+			data->num_generated = 0;
+		}
+		break;
+
+	case MAX30100_REG_FIFO_WR:
+	case MAX30100_REG_FIFO_OVF:
+	case MAX30100_REG_FIFO_RD:
+		data->regs[reg] = value & ((MAX30100_REG_FIFO_OVF == reg) ?
+					   MAX30100_OVF_MAX :
+					   MAX30100_FIFO_PTR_MASK);
+		data->num_stored = (data->regs[MAX30100_REG_FIFO_WR] -
+				    data->regs[MAX30100_REG_FIFO_RD]) &
+				   MAX30100_FIFO_PTR_MASK;
+		data->byte_idx = 0;
+		break;
+
+	case MAX30100_REG_INT_STAT:
+	case MAX30100_REG_FIFO_DATA:
+	case MAX30100_REG_REV_ID:
+	case MAX30100_REG_PART_ID:
+		/* Read-only */
+		break;
+
+	default:
+		data->regs[reg] = value;
+		break;
+	}
+}
+
+static int max30100_emul_transfer(const struct emul *target,
+				  struct i2c_msg *msgs, int num_msgs, int addr)
+{
+	struct max30100_emul_data *data = target->data;
+	bool have_reg = false;
+	uint8_t reg = 0;
+
+	ARG_UNUSED(addr);
+
+	max30100_emul_update(target);
+
+	for (int i = 0; i < num_msgs; i++) {
+		for (uint32_t j = 0; j < msgs[i].len; j++) {
+			if (msgs[i].flags & I2C_MSG_READ) {
+				if (!have_reg) {
+					LOG_ERR("Read without a register address");
+					return -EIO;
+				}
+
+				if (MAX30100_REG_FIFO_DATA == reg) {
+					msgs[i].buf[j] = max30100_emul_pop(data);
+					/* The FIFO data address does not advance */
+					continue;
+				}
+
+				msgs[i].buf[j] = data->regs[reg];
+
+				/* The interrupt status clears on read */
+				if (MAX30100_REG_INT_STAT == reg) {
+					data->regs[reg] = 0;
+				}
+			} else if (!have_reg) {
+				reg = msgs[i].buf[j];
+				have_reg = true;
+				continue;
+			} else {
+				max30100_emul_write(target, reg, msgs[i].buf[j]);
+
+				if (MAX30100_REG_FIFO_DATA == reg) {
+					continue;
+				}
+			}
+
+			reg++;
+		}
+	}
+
+	return 0;
+}
+
+void max30100_emul_set_signal(const struct emul *target,
+			      max30100_emul_signal_t signal, void *user_data)
+{
+	struct max30100_emul_data *data = target->data;
+
+	data->signal = signal;
+	data->user_data = user_data;
+}
+
+static int max30100_emul_init(const struct emul *target,
+			      const struct device *parent)
+{
+	ARG_UNUSED(parent);
+
+	max30100_emul_reset(target->data);
+
+	return 0;
+}
+
+static const struct i2c_emul_api max30100_emul_api = {
+	.transfer = max30100_emul_transfer,
+};
+
+#define MAX30100_EMUL_DEFINE(inst)						\
+	static struct max30100_emul_data max30100_emul_data_##inst;		\
+										\
+	EMUL_DT_INST_DEFINE(inst, max30100_emul_init,				\
+			    &max30100_emul_data_##inst, NULL,			\
+			    &max30100_emul_api, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(MAX30100_EMUL_DEFINE)
@@ -0,0 +1,22 @@
+#ifndef _MAX30100_EMUL_H_
+#define _MAX30100_EMUL_H_
+
+#include <stdint.h>
+#include <zephyr/drivers/emul.h>
+
+/*
+ * Provides the IR and red values of sample number num, counted from the
+ * moment the emulated sensor left shutdown
+ */
+typedef void (*max30100_emul_signal_t)(const struct emul *target, uint32_t num,
+				       uint16_t *ir, uint16_t *red,
+				       void *user_data);
+
+/*
+ * Sets the signal the emulated sensor samples. Without one the FIFO fills
+ * with zeros.
+ */
+void max30100_emul_set_signal(const struct emul *target,
+			      max30100_emul_signal_t signal, void *user_data);
+
+#endif /* _MAX30100_EMUL_H_ */
\ No newline at end of file
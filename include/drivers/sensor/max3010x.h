@@ -0,0 +1,20 @@
+#ifndef _MAX3010X_H_
+#define _MAX3010X_H_
+
+#include <zephyr/drivers/sensor.h>
+
+/* Driver specific channels of the MAX30100/MAX30101/MAX30102 driver */
+enum sensor_channel_max3010x {
+	/* Samples read from the FIFO in the last burst and not fetched yet */
+	SENSOR_CHAN_MAX3010X_PENDING = SENSOR_CHAN_PRIV_START,
+	/*
+	 * Samples lost to a FIFO overflow next to the fetched sample. A full
+	 * FIFO drops the newest samples, they are reported with the last
+	 * sample of a burst and were lost after it. With fifo-rollover-en the
+	 * oldest ones are overwritten instead, they are reported with the
+	 * first sample of a burst and were lost before it.
+	 */
+	SENSOR_CHAN_MAX3010X_LOST,
+};
+
+#endif /* _MAX3010X_H_ */
\ No newline at end of file
@@ -61,9 +61,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-bool checkForBeat(int32_t sample, int16_t *p_amplitude);
-int16_t averageDCEstimator(int32_t *p, uint16_t x);
-int16_t lowPassFIRFilter(int16_t din);
-int32_t mul16(int16_t x, int16_t y);
+bool checkForBeat(int32_t sample, int32_t *p_amplitude, int16_t *p_peak_offset);
+int32_t getACSignal(void);
+uint8_t getBeatDetectorDelay(void);
+void resetBeatDetector(void);
+void setBeatDetectorResolution(uint8_t bits);
+int32_t averageDCEstimator(int64_t *p, uint32_t x);
+int32_t lowPassFIRFilter(int32_t din);
+int64_t mul32(int32_t x, int32_t y);
 
 #endif /* _HEARTRATE_H_ */
\ No newline at end of file
@@ -57,34 +57,53 @@
 
 #include "heartRate.h"
 
+#include <string.h>
+
+#include "pba_fir.h"
+
 #define MODIFIED_ALGO 1
 
-int16_t IR_AC_Max = 20;
-int16_t IR_AC_Min = -20;
+int32_t IR_AC_Max = 20;
+int32_t IR_AC_Min = -20;
 
-int16_t IR_AC_Signal_Current = 0;
-int16_t IR_AC_Signal_Previous;
-int16_t IR_AC_Signal_min = 0;
-int16_t IR_AC_Signal_max = 0;
-int16_t IR_Average_Estimated;
+int32_t IR_AC_Signal_Current = 0;
+int32_t IR_AC_Signal_Previous;
+int32_t IR_AC_Signal_PrePrevious;
+int32_t IR_AC_Signal_min = 0;
+int32_t IR_AC_Signal_max = 0;
+int32_t IR_Average_Estimated;
 
 int16_t positiveEdge = 0;
 int16_t negativeEdge = 0;
-int32_t ir_avg_reg = 0;
+int64_t ir_avg_reg = 0;
 
-int16_t cbuf[32];
+int32_t cbuf[32];
 uint8_t offset = 0;
 
-static const uint16_t FIRCoeffs[12] = {172, 321, 579, 927, 1360, 1858, 2390, 2916, 3391, 3768, 4012, 4096};
+//  Beat amplitude limits, tuned for 16-bit samples and scaled up for sensors
+//  with more resolution
+int32_t beatAmplitudeMin = 20;
+int32_t beatAmplitudeMax = 1000;
+
+//  Folded low-pass taps, outermost first and the centre tap last, designed
+//  for the sample rate when building
+static const int32_t FIRCoeffs[PBA_FIR_NUM_FOLDED] = PBA_FIR_COEFS_FOLDED_Q;
+
+_Static_assert(PBA_FIR_NUM_TAPS <= 32, "Low-pass longer than the sample history");
+
+static int16_t interpolatePeakOffset(int32_t y0, int32_t y1, int32_t y2);
 
 //  Heart Rate Monitor functions takes a sample value and the sample number
 //  Returns true if a beat is detected
 //  A running average of four samples is recommended for display on the screen.
-bool checkForBeat(int32_t sample, int16_t *p_amplitude)
+//  On a detected beat, p_peak_offset receives the position of the interpolated
+//  peak relative to the current sample, in 1/256 sample units (always <= 0).
+bool checkForBeat(int32_t sample, int32_t *p_amplitude, int16_t *p_peak_offset)
 {
   bool beatDetected = false;
 
   //  Save current state
+  IR_AC_Signal_PrePrevious = IR_AC_Signal_Previous;
   IR_AC_Signal_Previous = IR_AC_Signal_Current;
   
   //This is good to view for debugging
@@ -108,11 +127,12 @@ bool checkForBeat(int32_t sample, int16_t *p_amplitude)
 
 #ifndef MODIFIED_ALGO
     //if ((IR_AC_Max - IR_AC_Min) > 100 & (IR_AC_Max - IR_AC_Min) < 1000)
-    if (((IR_AC_Max - IR_AC_Min) > 20) && ((IR_AC_Max - IR_AC_Min) < 1000))
+    if (((IR_AC_Max - IR_AC_Min) > beatAmplitudeMin) && ((IR_AC_Max - IR_AC_Min) < beatAmplitudeMax))
     {
       //Heart beat!!!
       beatDetected = true;
       *p_amplitude = IR_AC_Max - IR_AC_Min;
+      *p_peak_offset = 0;
     }
 #endif /* MODIFIED_ALGO */
   }
@@ -120,10 +140,14 @@ bool checkForBeat(int32_t sample, int16_t *p_amplitude)
 #ifdef MODIFIED_ALGO
   // Local maximum detection
   if (positiveEdge && (IR_AC_Signal_Current < IR_AC_Signal_Previous)
-      && ((IR_AC_Max - IR_AC_Min) > 20) && ((IR_AC_Max - IR_AC_Min) < 1000))
+      && ((IR_AC_Max - IR_AC_Min) > beatAmplitudeMin) && ((IR_AC_Max - IR_AC_Min) < beatAmplitudeMax))
   {
     beatDetected = true;
     *p_amplitude = IR_AC_Max - IR_AC_Min;
+    // The local maximum is the previous sample, refine it with its neighbours
+    *p_peak_offset = -256 + interpolatePeakOffset(IR_AC_Signal_PrePrevious,
+                                                  IR_AC_Signal_Previous,
+                                                  IR_AC_Signal_Current);
     positiveEdge = 0;
     negativeEdge = 1;
   }
@@ -152,33 +176,107 @@ bool checkForBeat(int32_t sample, int16_t *p_amplitude)
   return(beatDetected);
 }
 
+//  Band-passed signal the beat detector works on, for the latest sample
+int32_t getACSignal(void)
+{
+  return IR_AC_Signal_Current;
+}
+
+//  Delay of the band-passed signal behind the samples, in samples. Beats are
+//  detected on that signal, so their peaks lag the pulse by this much.
+uint8_t getBeatDetectorDelay(void)
+{
+  return PBA_FIR_GROUP_DELAY;
+}
+
+//  Returns the detector to its power-on state, e.g. after sampling was paused
+//  and the DC estimate and filter history no longer match the signal
+void resetBeatDetector(void)
+{
+  IR_AC_Max = 20;
+  IR_AC_Min = -20;
+
+  IR_AC_Signal_Current = 0;
+  IR_AC_Signal_Previous = 0;
+  IR_AC_Signal_PrePrevious = 0;
+  IR_AC_Signal_min = 0;
+  IR_AC_Signal_max = 0;
+  IR_Average_Estimated = 0;
+
+  positiveEdge = 0;
+  negativeEdge = 0;
+  ir_avg_reg = 0;
+
+  memset(cbuf, 0, sizeof(cbuf));
+  offset = 0;
+}
+
+//  Scales the beat amplitude limits to the sample resolution of the sensor,
+//  e.g. 16 for the MAX30100 and 18 for the MAX30101/MAX30102
+void setBeatDetectorResolution(uint8_t bits)
+{
+  uint8_t shift = (bits > 16) ? (bits - 16) : 0;
+
+  beatAmplitudeMin = 20 << shift;
+  beatAmplitudeMax = 1000 << shift;
+}
+
+//  Parabolic interpolation of a local maximum
+//  Fits a parabola through three equally spaced samples with y1 as the largest
+//  and returns the vertex position relative to y1 in 1/256 sample units
+static int16_t interpolatePeakOffset(int32_t y0, int32_t y1, int32_t y2)
+{
+  int32_t den = (int32_t) y0 - 2 * (int32_t) y1 + (int32_t) y2;
+  int32_t offset;
+
+  if (den >= 0)
+  {
+    // Flat or not a maximum, keep the sample position
+    return 0;
+  }
+
+  offset = (128 * ((int32_t) y0 - (int32_t) y2)) / den;
+
+  if (offset > 128)
+  {
+    offset = 128;
+  }
+  else if (offset < -128)
+  {
+    offset = -128;
+  }
+
+  return (int16_t) offset;
+}
+
 //  Average DC Estimator
-int16_t averageDCEstimator(int32_t *p, uint16_t x)
+//  64-bit state, an 18-bit sample shifted by 15 does not fit 32 bits
+int32_t averageDCEstimator(int64_t *p, uint32_t x)
 {
-  *p += ((((long) x << 15) - *p) >> 4);
-  return (*p >> 15);
+  *p += ((((int64_t) x << 15) - *p) >> 4);
+  return (int32_t) (*p >> 15);
 }
 
 //  Low Pass FIR Filter
-int16_t lowPassFIRFilter(int16_t din)
+int32_t lowPassFIRFilter(int32_t din)
 {  
   cbuf[offset] = din;
 
-  int32_t z = mul16(FIRCoeffs[11], cbuf[(offset - 11) & 0x1F]);
+  int64_t z = mul32(FIRCoeffs[PBA_FIR_GROUP_DELAY], cbuf[(offset - PBA_FIR_GROUP_DELAY) & 0x1F]);
   
-  for (uint8_t i = 0 ; i < 11 ; i++)
+  for (uint8_t i = 0 ; i < PBA_FIR_GROUP_DELAY ; i++)
   {
-    z += mul16(FIRCoeffs[i], cbuf[(offset - i) & 0x1F] + cbuf[(offset - 22 + i) & 0x1F]);
+    z += mul32(FIRCoeffs[i], cbuf[(offset - i) & 0x1F] + cbuf[(offset - (PBA_FIR_NUM_TAPS - 1) + i) & 0x1F]);
   }
 
   offset++;
   offset %= 32; //Wrap condition
 
-  return(z >> 15);
+  return (int32_t) (z >> PBA_FIR_FRAC_BITS);
 }
 
 //  Integer multiplier
-int32_t mul16(int16_t x, int16_t y)
+int64_t mul32(int32_t x, int32_t y)
 {
-  return((long)x * (long)y);
+  return((int64_t)x * (int64_t)y);
 }
\ No newline at end of file
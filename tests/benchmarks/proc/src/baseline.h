@@ -0,0 +1,37 @@
+#ifndef _BASELINE_H_
+#define _BASELINE_H_
+
+#include "bench.h"
+
+// Nanoseconds per operation, as printed by a run with CONFIG_BENCH_RECORD=y.
+// QEMU runs in icount mode, so they follow the executed instructions and do
+// not depend on the machine. A zero entry fails the check until a baseline is
+// recorded, testcase.yaml leaves qemu_riscv32 out until then. native_sim has
+// no baselines, its clock does not advance while code runs.
+#if defined(CONFIG_BOARD_QEMU_RISCV32)
+
+#define BENCH_HAVE_BASELINES 1
+
+static const uint32_t bench_baseline_ns[BENCH_NUM] = {
+    [BENCH_RING_BUFFER_PUT] = 0,
+    [BENCH_RING_BUFFER_MOV_AVG] = 0,
+    [BENCH_RING_BUFFER_COPY_INORDER] = 0,
+    [BENCH_LOW_PASS_FIR_FILTER] = 0,
+    [BENCH_CHECK_FOR_BEAT] = 0,
+    [BENCH_PPG_PUT_SAMPLE] = 0,
+    [BENCH_RESP_PUT_BEAT] = 0,
+    [BENCH_EDA_FIR_FILTER] = 0,
+    [BENCH_MV_TO_EDA_NS] = 0,
+    [BENCH_CODE_TO_EDA_NS] = 0,
+    [BENCH_EDA_PUT_SAMPLE] = 0,
+};
+
+#else
+
+#define BENCH_HAVE_BASELINES 0
+
+static const uint32_t bench_baseline_ns[BENCH_NUM];
+
+#endif
+
+#endif /* _BASELINE_H_ */
\ No newline at end of file
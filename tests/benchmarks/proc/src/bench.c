@@ -0,0 +1,84 @@
+/**
+ * Cycle benchmarks of the signal processing core, with a regression check
+ * against stored per-board baselines.
+ *
+ * Each benchmark times BENCH_ITERATIONS operations with the cycle counter,
+ * the same one the on-target profiling uses, and also checks that the code
+ * under test still computes the right thing. Results are compared in
+ * nanoseconds per operation, since the cycle counter of qemu_riscv32 runs
+ * at 10 MHz and would round most operations to zero cycles.
+*/
+
+#include "bench.h"
+
+#include <zephyr/ztest.h>
+
+#include "baseline.h"
+
+volatile int64_t bench_sink;
+
+static const char *const bench_names[BENCH_NUM] = {
+    [BENCH_RING_BUFFER_PUT] = "ring_buffer_put",
+    [BENCH_RING_BUFFER_MOV_AVG] = "ring_buffer_mov_avg",
+    [BENCH_RING_BUFFER_COPY_INORDER] = "ring_buffer_copy_inorder",
+    [BENCH_LOW_PASS_FIR_FILTER] = "lowPassFIRFilter",
+    [BENCH_CHECK_FOR_BEAT] = "checkForBeat",
+    [BENCH_PPG_PUT_SAMPLE] = "ppg_proc_put_sample",
+    [BENCH_RESP_PUT_BEAT] = "resp_put_beat",
+    [BENCH_EDA_FIR_FILTER] = "fir_filter",
+    [BENCH_MV_TO_EDA_NS] = "mv_to_eda_ns",
+    [BENCH_CODE_TO_EDA_NS] = "code_to_eda_ns",
+    [BENCH_EDA_PUT_SAMPLE] = "eda_proc_put_sample",
+};
+
+// Enumerator names, for printing a baseline table in record mode
+static const char *const bench_ids[BENCH_NUM] = {
+    [BENCH_RING_BUFFER_PUT] = "BENCH_RING_BUFFER_PUT",
+    [BENCH_RING_BUFFER_MOV_AVG] = "BENCH_RING_BUFFER_MOV_AVG",
+    [BENCH_RING_BUFFER_COPY_INORDER] = "BENCH_RING_BUFFER_COPY_INORDER",
+    [BENCH_LOW_PASS_FIR_FILTER] = "BENCH_LOW_PASS_FIR_FILTER",
+    [BENCH_CHECK_FOR_BEAT] = "BENCH_CHECK_FOR_BEAT",
+    [BENCH_PPG_PUT_SAMPLE] = "BENCH_PPG_PUT_SAMPLE",
+    [BENCH_RESP_PUT_BEAT] = "BENCH_RESP_PUT_BEAT",
+    [BENCH_EDA_FIR_FILTER] = "BENCH_EDA_FIR_FILTER",
+    [BENCH_MV_TO_EDA_NS] = "BENCH_MV_TO_EDA_NS",
+    [BENCH_CODE_TO_EDA_NS] = "BENCH_CODE_TO_EDA_NS",
+    [BENCH_EDA_PUT_SAMPLE] = "BENCH_EDA_PUT_SAMPLE",
+};
+
+void bench_check(bench_id_t id, uint32_t cycles, uint32_t num_ops)
+{
+    uint32_t ns_per_op = (uint32_t) (k_cyc_to_ns_floor64(cycles) / num_ops);
+    uint32_t cycles_per_op_x100 = (uint32_t) (((uint64_t) cycles * 100U) / num_ops);
+    uint32_t baseline_ns = bench_baseline_ns[id];
+
+    TC_PRINT("%-26s %8u.%02u cycles/op %8u ns/op, baseline %u ns/op\n",
+             bench_names[id], cycles_per_op_x100 / 100U, cycles_per_op_x100 % 100U,
+             ns_per_op, baseline_ns);
+
+    if (IS_ENABLED(CONFIG_BENCH_RECORD))
+    {
+        TC_PRINT("    [%s] = %u,\n", bench_ids[id], ns_per_op);
+        return;
+    }
+
+    if (0 == cycles)
+    {
+        TC_PRINT("%-26s clock did not advance, not checked\n", bench_names[id]);
+        return;
+    }
+
+    if (!BENCH_HAVE_BASELINES)
+    {
+        TC_PRINT("%-26s WARNING: no baselines for this board, not checked\n", bench_names[id]);
+        return;
+    }
+
+    zassert_not_equal(baseline_ns, 0, "%s has no baseline, record one with CONFIG_BENCH_RECORD=y",
+                      bench_names[id]);
+
+    zassert_true((uint64_t) ns_per_op * 100U <=
+                 (uint64_t) baseline_ns * (100U + CONFIG_BENCH_TOLERANCE_PCT),
+                 "%s regressed: %u ns/op, baseline %u ns/op + %u%%",
+                 bench_names[id], ns_per_op, baseline_ns, CONFIG_BENCH_TOLERANCE_PCT);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#define BENCH_ITERATIONS CONFIG_BENCH_ITERATIONS
+
+typedef enum bench_id
+{
+    BENCH_RING_BUFFER_PUT,
+    BENCH_RING_BUFFER_MOV_AVG,
+    BENCH_RING_BUFFER_COPY_INORDER,
+    BENCH_LOW_PASS_FIR_FILTER,
+    BENCH_CHECK_FOR_BEAT,
+    BENCH_PPG_PUT_SAMPLE,
+    BENCH_RESP_PUT_BEAT,
+    BENCH_EDA_FIR_FILTER,
+    BENCH_MV_TO_EDA_NS,
+    BENCH_CODE_TO_EDA_NS,
+    BENCH_EDA_PUT_SAMPLE,
+    BENCH_NUM,
+} bench_id_t;
+
+// Written by the timed loops, so the compiler cannot drop the timed code
+extern volatile int64_t bench_sink;
+
+// Reports the cost per operation of a timed loop and fails the test if it
+// regressed past the baseline of the board
+void bench_check(bench_id_t id, uint32_t cycles, uint32_t num_ops);
+
+#endif /* _BENCH_H_ */
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include <zephyr/ztest.h>
+
+#include <string.h>
+
+#include "bench.h"
+#include "metrics.h"
+#include "eda_proc.h"
+#include "eda_proc_test.h"
+#include "eda_fir.h"
+
+// Full scale of the ESP32-C3 ADC without attenuation
+#define FULL_SCALE_MV 1100
+
+// Raw code of the resting level and of the peak of a response
+#define EDA_REST_CODE 1800
+#define EDA_SCR_CODE 150
+
+// Same taps as the EDA core, from the same generated header
+static const int32_t bench_filt_coefs[EDA_FIR_NUM_FOLDED] = EDA_FIR_COEFS_FOLDED_Q;
+static int32_t bench_filt_buf[EDA_FIR_NUM_TAPS];
+
+static void *bench_eda_setup(void)
+{
+    zassert_equal(eda_proc_init(), 0);
+
+    return NULL;
+}
+
+static void bench_eda_before(void *p_fixture)
+{
+    const eda_cal_t cal = {
+        .gain = 1 << EDA_CAL_GAIN_FRAC_BITS,
+        .offset = EDA_CAL_DEFAULT_OFFSET,
+    };
+
+    ARG_UNUSED(p_fixture);
+
+    memset(bench_filt_buf, 0, sizeof(bench_filt_buf));
+
+    zassert_equal(eda_proc_reset(), 0);
+    eda_proc_set_cal(&cal, FULL_SCALE_MV);
+}
+
+ZTEST(bench_eda, test_fir_filter)
+{
+    const int32_t code = 1000 << EDA_CODE_FRAC_BITS;
+    uint32_t start;
+    int32_t out = 0;
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        out = fir_filter(code + (int32_t) (i & 0x3F), bench_filt_buf, bench_filt_coefs,
+                         EDA_FIR_NUM_TAPS);
+        bench_sink += out;
+    }
+
+    bench_check(BENCH_EDA_FIR_FILTER, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    // Unity gain at DC
+    for (size_t i = 0; i < EDA_FIR_NUM_TAPS; i++)
+    {
+        out = fir_filter(code, bench_filt_buf, bench_filt_coefs, EDA_FIR_NUM_TAPS);
+    }
+    zassert_within(out, code, 1, "DC gain off: %d", out);
+}
+
+ZTEST(bench_eda, test_mv_to_eda_ns)
+{
+    uint32_t start;
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        bench_sink += (int64_t) mv_to_eda_ns(100.0f + (float) (i & 0xFF));
+    }
+
+    bench_check(BENCH_MV_TO_EDA_NS, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    // Half the reference across the divider: Rs equals the 200k resistor
+    zassert_within(mv_to_eda_ns(EDA_U_REF_MV / 2.0f), 5000.0f, 1.0f);
+}
+
+// Table lookup that replaced mv_to_eda_ns() in the sample path
+ZTEST(bench_eda, test_code_to_eda_ns)
+{
+    const int32_t max_code = 1 << (EDA_ADC_RESOLUTION_BITS + EDA_CODE_FRAC_BITS);
+    uint32_t prev = 0;
+    uint32_t eda_ns;
+    uint32_t start;
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        bench_sink += code_to_eda_ns((int32_t) ((i * 97U) % max_code));
+    }
+
+    bench_check(BENCH_CODE_TO_EDA_NS, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    for (int32_t code = 0; code < max_code; code += 7)
+    {
+        eda_ns = code_to_eda_ns(code);
+        zassert_true(eda_ns >= prev, "not monotonic at code %d", code);
+        prev = eda_ns;
+    }
+}
+
+// The whole path of a raw EDA sample, from averaging to the published metrics
+// snapshot, with a skin conductance response every 20 s
+ZTEST(bench_eda, test_put_sample)
+{
+    uint32_t num_scr = 0;
+    uint32_t version;
+    uint32_t start;
+    uint32_t t;
+    uint16_t raw;
+
+    version = metrics_get_version(METRICS_TOPIC_EDA);
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        // Linear rise over 1 s, linear recovery over 4 s
+        t = i % 2000;
+        raw = EDA_REST_CODE;
+        if ((t >= 1000) && (t < 1100))
+        {
+            raw += (EDA_SCR_CODE * (t - 1000)) / 100;
+        }
+        else if ((t >= 1100) && (t < 1500))
+        {
+            raw += (EDA_SCR_CODE * (1500 - t)) / 400;
+        }
+
+        if (eda_proc_put_sample(raw, NULL))
+        {
+            num_scr++;
+        }
+    }
+
+    bench_check(BENCH_EDA_PUT_SAMPLE, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    zassert_not_equal(metrics_get_version(METRICS_TOPIC_EDA), version, "nothing published");
+    zassert_true(num_scr > 0, "no SCR detected");
+}
+
+ZTEST_SUITE(bench_eda, NULL, bench_eda_setup, bench_eda_before, NULL, NULL);
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include <zephyr/ztest.h>
+#include <math.h>
+
+#include "bench.h"
+#include "ppg_proc.h"
+#include "metrics.h"
+#include "heartRate.h"
+#include "resp.h"
+
+#define PPG_DC_IR 50000
+#define PPG_DC_RED 40000
+
+// Beats of the respiratory rate benchmark, breathing modulates all three
+// series like it does on a wrist
+#define RESP_BEAT_MS 857.0f
+#define RESP_BREATHS_PER_MIN 15
+
+// One beat sampled at 50 Hz, 71 bpm, a systolic peak and a dicrotic wave
+static const int16_t pulse[] = {
+    0, 0, 2, 15, 71, 243, 606, 1102, 1463, 1417, 1003, 520, 204, 81,
+    82, 158, 285, 436, 558, 599, 539, 406, 256, 135, 60, 22, 7, 2,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#define PULSE_BPM (60000 / (ARRAY_SIZE(pulse) * PPG_SAMPLE_PERIOD_MS))
+
+static inline int32_t ir_sample(uint32_t i)
+{
+    return PPG_DC_IR + pulse[i % ARRAY_SIZE(pulse)];
+}
+
+static inline int32_t red_sample(uint32_t i)
+{
+    return PPG_DC_RED + (2 * pulse[i % ARRAY_SIZE(pulse)]) / 3;
+}
+
+static void *bench_ppg_setup(void)
+{
+    zassert_equal(ppg_proc_init(), 0);
+
+    return NULL;
+}
+
+static void bench_ppg_before(void *p_fixture)
+{
+    ARG_UNUSED(p_fixture);
+
+    setBeatDetectorResolution(16);
+    resetBeatDetector();
+}
+
+ZTEST(bench_ppg, test_low_pass_fir_filter)
+{
+    uint32_t start;
+    int32_t out = 0;
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        out = lowPassFIRFilter(pulse[i % ARRAY_SIZE(pulse)]);
+        bench_sink += out;
+    }
+
+    bench_check(BENCH_LOW_PASS_FIR_FILTER, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    // The filter is designed with a DC gain of CONFIG_APP_PPG_FIR_GAIN_PCT
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        out = lowPassFIRFilter(1000);
+    }
+    zassert_within(out, 10 * CONFIG_APP_PPG_FIR_GAIN_PCT, 1, "DC gain off: %d", out);
+}
+
+ZTEST(bench_ppg, test_check_for_beat)
+{
+    uint32_t num_beats = 0;
+    uint32_t start;
+    int32_t amplitude;
+    int16_t peak_offset;
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        if (checkForBeat(ir_sample(i), &amplitude, &peak_offset))
+        {
+            num_beats++;
+        }
+    }
+
+    bench_check(BENCH_CHECK_FOR_BEAT, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    // Every beat after the DC estimator settled
+    zassert_within(num_beats, BENCH_ITERATIONS / ARRAY_SIZE(pulse), 5,
+                   "%u beats", num_beats);
+}
+
+// The whole path of a PPG sample, from the beat detector to the published
+// metrics snapshot
+ZTEST(bench_ppg, test_put_sample)
+{
+    uint32_t version;
+    uint32_t start;
+    metrics_ppg_t metrics;
+
+    zassert_equal(ppg_proc_reset(), 0);
+    ppg_proc_set_resolution(16);
+
+    version = metrics_get_version(METRICS_TOPIC_PPG);
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        ppg_proc_put_sample(red_sample(i), ir_sample(i), NULL);
+    }
+
+    bench_check(BENCH_PPG_PUT_SAMPLE, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    zassert_not_equal(metrics_get_version(METRICS_TOPIC_PPG), version, "nothing published");
+
+    metrics_read(METRICS_TOPIC_PPG, &metrics, sizeof(metrics));
+    zassert_within(metrics.hr_bpm, PULSE_BPM, 2, "HR %u bpm", metrics.hr_bpm);
+}
+
+// Respiratory rate update per beat, three sliding DFTs over the breathing band
+ZTEST(bench_ppg, test_resp_put_beat)
+{
+    const float w = 2.0f * 3.14159265f * RESP_BREATHS_PER_MIN / 60000.0f;
+    float t_ms = 0.0f;
+    float br;
+    uint32_t start;
+    uint32_t rate;
+
+    zassert_equal(resp_reset(), 0);
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        br = sinf(w * t_ms);
+        resp_put_beat(RESP_BEAT_MS, 1000.0f + 70.0f * br, 40000.0f + 60.0f * br,
+                      RESP_BEAT_MS + 30.0f * br);
+        t_ms += RESP_BEAT_MS;
+    }
+
+    bench_check(BENCH_RESP_PUT_BEAT, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    rate = resp_get_rate_bpm();
+    zassert_within(rate, RESP_BREATHS_PER_MIN, 1, "%u breaths/min", rate);
+    zassert_equal(resp_get_quality(), RESP_QUALITY_GOOD);
+}
+
+ZTEST_SUITE(bench_ppg, NULL, bench_ppg_setup, bench_ppg_before, NULL, NULL);
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+#include "ring_buffer.h"
+
+// Same size as the EDA window
+#define BUF_SIZE 100
+
+static float buf[BUF_SIZE];
+static float copy_buf[BUF_SIZE];
+static ring_buffer_t ring_buf;
+
+static void bench_ring_buffer_before(void *p_fixture)
+{
+    ARG_UNUSED(p_fixture);
+
+    zassert_equal(ring_buffer_init(&ring_buf, buf, BUF_SIZE), 0);
+}
+
+static void fill(size_t num_items)
+{
+    for (size_t i = 0; i < num_items; i++)
+    {
+        ring_buffer_put(&ring_buf, (float) i);
+    }
+}
+
+ZTEST(bench_ring_buffer, test_put)
+{
+    uint32_t start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        ring_buffer_put(&ring_buf, (float) (i & 0xFF));
+    }
+
+    bench_check(BENCH_RING_BUFFER_PUT, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    zassert_equal(ring_buffer_get_num_items(&ring_buf), BUF_SIZE);
+}
+
+ZTEST(bench_ring_buffer, test_mov_avg)
+{
+    uint32_t start;
+    float avg;
+
+    fill(BUF_SIZE);
+
+    zassert_equal(ring_buffer_mov_avg(&ring_buf, &avg), 0);
+    zassert_within(avg, (BUF_SIZE - 1) / 2.0f, 1e-3f);
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        ring_buffer_mov_avg(&ring_buf, &avg);
+        bench_sink += (int64_t) avg;
+    }
+
+    bench_check(BENCH_RING_BUFFER_MOV_AVG, k_cycle_get_32() - start, BENCH_ITERATIONS);
+}
+
+ZTEST(bench_ring_buffer, test_copy_inorder)
+{
+    uint32_t start;
+
+    // Wrap around, so the copy has to join two spans
+    fill(BUF_SIZE + BUF_SIZE / 2);
+
+    start = k_cycle_get_32();
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        ring_buffer_copy_inorder(&ring_buf, copy_buf);
+        bench_sink += (int64_t) copy_buf[i % BUF_SIZE];
+    }
+
+    bench_check(BENCH_RING_BUFFER_COPY_INORDER, k_cycle_get_32() - start, BENCH_ITERATIONS);
+
+    for (size_t i = 0; i < BUF_SIZE; i++)
+    {
+        zassert_equal(copy_buf[i], (float) (BUF_SIZE / 2 + i), "item %zu out of order", i);
+    }
+}
+
+ZTEST_SUITE(bench_ring_buffer, NULL, NULL, bench_ring_buffer_before, NULL, NULL);
\ No newline at end of file
@@ -0,0 +1,561 @@
+/**
+ * Central side of the notification throughput and latency test.
+ *
+ * Connects to the peripheral with the connection interval, ATT MTU and PHY
+ * given as test arguments, subscribes to the metrics characteristic for a
+ * while and reports:
+ * - notifications per second and payload bytes per second received,
+ * - the age of the newest metrics snapshot in each notification on
+ *   arrival (sample to air) and the time from queueing to arrival,
+ * - the share of messages the peripheral's stack refused.
+ * The peripheral tells about every notification it queued over the
+ * backchannel, both devices share the simulated clock.
+ *
+ * Test arguments (-argstest):
+ *   interval=<n>        connection interval in 1.25 ms units, default 24
+ *   mtu=<23|247>        ATT MTU, 247 also extends the data length
+ *   phy=<1m|2m|coded>   PHY, default 1m
+ *   duration_s=<s>      time subscribed, default 60
+ *   max_drop_pct=<pct>  fail above this share of refused messages
+ *   max_latency_ms=<ms> fail above this sample to air latency
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#include "bs_types.h"
+#include "bs_tracing.h"
+#include "bstests.h"
+#include "bs_pc_backchannel.h"
+
+#include "notify_test.h"
+
+#define FAIL(...)                                   \
+    do                                              \
+    {                                               \
+        bst_result = Failed;                        \
+        bs_trace_error_time_line(__VA_ARGS__);      \
+    } while (0)
+
+#define PASS(...)                                   \
+    do                                              \
+    {                                               \
+        bst_result = Passed;                        \
+        bs_trace_info_time(1, __VA_ARGS__);         \
+    } while (0)
+
+#define TEST_TIMEOUT_US (30 * 60 * 1000000ULL)
+
+#define SETUP_TIMEOUT K_SECONDS(10)
+
+#define DEFAULT_MTU 23
+
+// Supervision timeout in 10 ms units, long enough for the slowest interval
+#define SUPERVISION_TIMEOUT 400
+
+// Backchannel records kept for matching, far more than can be in flight
+#define NUM_RECS 64
+
+extern enum bst_result_t bst_result;
+
+typedef struct latency_stats
+{
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t num;
+} latency_stats_t;
+
+static const uint8_t svc_uuid[] = {
+    BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x1234, 0x56789abcdef0)
+};
+
+static const struct bt_uuid_128 chr_uuid = BT_UUID_INIT_128(
+    BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x1234, 0x56789abcdef1));
+
+static uint16_t arg_interval = 24;
+static uint16_t arg_mtu = DEFAULT_MTU;
+static const char *p_arg_phy = "1m";
+static uint32_t arg_duration_s = 60;
+static uint32_t arg_max_drop_pct = 100;
+static uint32_t arg_max_latency_ms = UINT32_MAX;
+
+static struct bt_conn *p_conn;
+static K_SEM_DEFINE(connected_sem, 0, 1);
+static K_SEM_DEFINE(disconnected_sem, 0, 1);
+static K_SEM_DEFINE(setup_sem, 0, 1);
+static int setup_err;
+
+static struct bt_gatt_exchange_params mtu_params;
+static struct bt_gatt_discover_params disc_params;
+static struct bt_gatt_subscribe_params sub_params;
+
+static notify_test_rec_t recs[NUM_RECS];
+static notify_test_rec_t last_rec;
+static uint32_t num_rx;
+static uint32_t num_rx_bytes;
+static uint32_t num_unmatched;
+static uint32_t first_rx_us;
+static uint32_t last_rx_us;
+static latency_stats_t sample_to_air;
+static latency_stats_t queue_to_air;
+
+static inline uint32_t now_us(void)
+{
+    return (uint32_t) k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void latency_add(latency_stats_t *p_stats, uint32_t latency_us)
+{
+    if ((0 == p_stats->num) || (latency_us < p_stats->min_us))
+    {
+        p_stats->min_us = latency_us;
+    }
+    if (latency_us > p_stats->max_us)
+    {
+        p_stats->max_us = latency_us;
+    }
+    p_stats->sum_us += latency_us;
+    p_stats->num++;
+}
+
+// Takes in the records the peripheral sent since the last notification
+static void recs_receive(void)
+{
+    notify_test_rec_t rec;
+
+    while (bs_bc_is_msg_received(NOTIFY_TEST_BACKCHANNEL) > 0)
+    {
+        bs_bc_receive_msg(NOTIFY_TEST_BACKCHANNEL, (uint8_t *) &rec, sizeof(rec));
+        recs[rec.seq % NUM_RECS] = rec;
+        last_rec = rec;
+    }
+}
+
+static uint8_t notify_cb(struct bt_conn *p_conn, struct bt_gatt_subscribe_params *p_params,
+                         const void *p_data, uint16_t length)
+{
+    uint32_t rx_us = now_us();
+    const notify_test_rec_t *p_rec;
+
+    if (!p_data)
+    {
+        p_params->value_handle = 0;
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (0 == num_rx)
+    {
+        first_rx_us = rx_us;
+    }
+    last_rx_us = rx_us;
+    num_rx++;
+    num_rx_bytes += length;
+
+    recs_receive();
+
+    // Notifications arrive in the order they were queued, without gaps
+    p_rec = &recs[num_rx % NUM_RECS];
+    if (p_rec->seq != num_rx)
+    {
+        num_unmatched++;
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    latency_add(&sample_to_air, rx_us - p_rec->publish_us);
+    latency_add(&queue_to_air, rx_us - p_rec->queue_us);
+
+    return BT_GATT_ITER_CONTINUE;
+}
+
+static bool ad_has_svc_uuid(struct bt_data *p_data, void *p_user_data)
+{
+    bool *p_found = p_user_data;
+
+    if ((BT_DATA_UUID128_ALL == p_data->type) &&
+        (p_data->data_len >= sizeof(svc_uuid)) &&
+        (0 == memcmp(p_data->data, svc_uuid, sizeof(svc_uuid))))
+    {
+        *p_found = true;
+        return false;
+    }
+
+    return true;
+}
+
+static void device_found(const bt_addr_le_t *p_addr, int8_t rssi, uint8_t type,
+                         struct net_buf_simple *p_ad)
+{
+    bool found = false;
+    int err;
+
+    if ((p_conn != NULL) || (type != BT_GAP_ADV_TYPE_ADV_IND))
+    {
+        return;
+    }
+
+    bt_data_parse(p_ad, ad_has_svc_uuid, &found);
+    if (!found)
+    {
+        return;
+    }
+
+    err = bt_le_scan_stop();
+    if (err < 0)
+    {
+        FAIL("Could not stop scanning (%d)\n", err);
+        return;
+    }
+
+    err = bt_conn_le_create(p_addr, BT_CONN_LE_CREATE_CONN,
+                            BT_LE_CONN_PARAM(arg_interval, arg_interval, 0, SUPERVISION_TIMEOUT),
+                            &p_conn);
+    if (err < 0)
+    {
+        FAIL("Could not connect (%d)\n", err);
+    }
+}
+
+static void connected(struct bt_conn *p_new_conn, uint8_t err)
+{
+    if (err)
+    {
+        FAIL("Connection failed (0x%02x)\n", err);
+        return;
+    }
+
+    k_sem_give(&connected_sem);
+}
+
+static void disconnected(struct bt_conn *p_old_conn, uint8_t reason)
+{
+    bt_conn_unref(p_conn);
+    p_conn = NULL;
+    k_sem_give(&disconnected_sem);
+}
+
+static void le_phy_updated(struct bt_conn *p_upd_conn, struct bt_conn_le_phy_info *p_info)
+{
+    k_sem_give(&setup_sem);
+}
+
+static void le_data_len_updated(struct bt_conn *p_upd_conn, struct bt_conn_le_data_len_info *p_info)
+{
+    k_sem_give(&setup_sem);
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+    .le_phy_updated = le_phy_updated,
+    .le_data_len_updated = le_data_len_updated,
+};
+
+static void mtu_exchanged(struct bt_conn *p_mtu_conn, uint8_t err,
+                          struct bt_gatt_exchange_params *p_params)
+{
+    setup_err = err;
+    k_sem_give(&setup_sem);
+}
+
+static uint8_t chr_discovered(struct bt_conn *p_disc_conn, const struct bt_gatt_attr *p_attr,
+                              struct bt_gatt_discover_params *p_params)
+{
+    const struct bt_gatt_chrc *p_chrc;
+
+    if (!p_attr)
+    {
+        setup_err = -ENOENT;
+        k_sem_give(&setup_sem);
+        return BT_GATT_ITER_STOP;
+    }
+
+    // The CCC descriptor follows the value, see the service definition
+    p_chrc = p_attr->user_data;
+    sub_params.value_handle = p_chrc->value_handle;
+    sub_params.ccc_handle = p_chrc->value_handle + 1;
+
+    setup_err = 0;
+    k_sem_give(&setup_sem);
+
+    return BT_GATT_ITER_STOP;
+}
+
+static int wait_setup(const char *p_step)
+{
+    if (k_sem_take(&setup_sem, SETUP_TIMEOUT) < 0)
+    {
+        FAIL("Timed out on %s\n", p_step);
+        return -ETIMEDOUT;
+    }
+
+    if (setup_err != 0)
+    {
+        FAIL("%s failed (%d)\n", p_step, setup_err);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+// Brings the link to the MTU and PHY of the run
+static int link_setup(void)
+{
+    const struct bt_conn_le_phy_param *p_phy = BT_CONN_LE_PHY_PARAM_1M;
+    int err;
+
+    if (arg_mtu > DEFAULT_MTU)
+    {
+        mtu_params.func = mtu_exchanged;
+        err = bt_gatt_exchange_mtu(p_conn, &mtu_params);
+        if ((err < 0) || (wait_setup("MTU exchange") < 0))
+        {
+            return -EIO;
+        }
+
+        setup_err = bt_conn_le_data_len_update(p_conn, BT_LE_DATA_LEN_PARAM_MAX);
+        if ((setup_err < 0) || (wait_setup("data length update") < 0))
+        {
+            return -EIO;
+        }
+    }
+
+    if (0 == strcmp(p_arg_phy, "2m"))
+    {
+        p_phy = BT_CONN_LE_PHY_PARAM_2M;
+    }
+    else if (0 == strcmp(p_arg_phy, "coded"))
+    {
+        p_phy = BT_CONN_LE_PHY_PARAM_CODED;
+    }
+
+    if (p_phy != BT_CONN_LE_PHY_PARAM_1M)
+    {
+        setup_err = bt_conn_le_phy_update(p_conn, p_phy);
+        if ((setup_err < 0) || (wait_setup("PHY update") < 0))
+        {
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+static int subscribe(void)
+{
+    disc_params.uuid = &chr_uuid.uuid;
+    disc_params.func = chr_discovered;
+    disc_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    disc_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    disc_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+    setup_err = bt_gatt_discover(p_conn, &disc_params);
+    if ((setup_err < 0) || (wait_setup("discovery") < 0))
+    {
+        return -EIO;
+    }
+
+    sub_params.notify = notify_cb;
+    sub_params.value = BT_GATT_CCC_NOTIFY;
+
+    return bt_gatt_subscribe(p_conn, &sub_params);
+}
+
+static void report(uint32_t elapsed_us)
+{
+    struct bt_conn_info info;
+    uint32_t num_queued = last_rec.seq;
+    uint32_t num_refused = last_rec.num_failed;
+    uint32_t drop_pct_x10 = 0;
+    uint32_t rate_x10 = (uint32_t) (((uint64_t) num_rx * 10U * USEC_PER_SEC) / elapsed_us);
+    uint32_t bytes_per_s = (uint32_t) (((uint64_t) num_rx_bytes * USEC_PER_SEC) / elapsed_us);
+    uint32_t sample_avg_us = sample_to_air.num ? (uint32_t) (sample_to_air.sum_us / sample_to_air.num) : 0;
+    uint32_t queue_avg_us = queue_to_air.num ? (uint32_t) (queue_to_air.sum_us / queue_to_air.num) : 0;
+    bool failed = false;
+
+    if (num_queued + num_refused > 0)
+    {
+        drop_pct_x10 = (num_refused * 1000U) / (num_queued + num_refused);
+    }
+
+    bt_conn_get_info(p_conn, &info);
+
+    printk("RESULT interval_us=%u mtu=%u phy=%s notifications=%u rate=%u.%u/s "
+           "bytes=%u/s queued=%u refused=%u drop=%u.%u%% in_flight=%u "
+           "sample_to_air_ms=%u/%u/%u queue_to_air_ms=%u/%u/%u\n",
+           info.le.interval * 1250U, bt_gatt_get_mtu(p_conn), p_arg_phy,
+           num_rx, rate_x10 / 10U, rate_x10 % 10U, bytes_per_s,
+           num_queued, num_refused, drop_pct_x10 / 10U, drop_pct_x10 % 10U,
+           num_queued - num_rx,
+           sample_to_air.min_us / 1000U, sample_avg_us / 1000U, sample_to_air.max_us / 1000U,
+           queue_to_air.min_us / 1000U, queue_avg_us / 1000U, queue_to_air.max_us / 1000U);
+
+    if (0 == num_rx)
+    {
+        FAIL("No notifications received\n");
+        failed = true;
+    }
+    if (num_unmatched > 0)
+    {
+        FAIL("%u notifications lost or out of order\n", num_unmatched);
+        failed = true;
+    }
+    if (drop_pct_x10 > arg_max_drop_pct * 10U)
+    {
+        FAIL("Drop rate above %u%%\n", arg_max_drop_pct);
+        failed = true;
+    }
+    if (sample_to_air.max_us / 1000U > arg_max_latency_ms)
+    {
+        FAIL("Sample to air latency above %u ms\n", arg_max_latency_ms);
+        failed = true;
+    }
+
+    if (!failed)
+    {
+        PASS("Central: run complete\n");
+    }
+}
+
+static void test_central_args(int argc, char *argv[])
+{
+    char *p_val;
+
+    for (int i = 0; i < argc; i++)
+    {
+        p_val = strchr(argv[i], '=');
+        if (!p_val)
+        {
+            bs_trace_error_line("Expected <name>=<value>, got %s\n", argv[i]);
+        }
+        *p_val++ = '\0';
+
+        if (0 == strcmp(argv[i], "interval"))
+        {
+            arg_interval = (uint16_t) strtoul(p_val, NULL, 0);
+        }
+        else if (0 == strcmp(argv[i], "mtu"))
+        {
+            arg_mtu = (uint16_t) strtoul(p_val, NULL, 0);
+        }
+        else if (0 == strcmp(argv[i], "phy"))
+        {
+            p_arg_phy = p_val;
+        }
+        else if (0 == strcmp(argv[i], "duration_s"))
+        {
+            arg_duration_s = strtoul(p_val, NULL, 0);
+        }
+        else if (0 == strcmp(argv[i], "max_drop_pct"))
+        {
+            arg_max_drop_pct = strtoul(p_val, NULL, 0);
+        }
+        else if (0 == strcmp(argv[i], "max_latency_ms"))
+        {
+            arg_max_latency_ms = strtoul(p_val, NULL, 0);
+        }
+        else
+        {
+            bs_trace_error_line("Unknown argument %s\n", argv[i]);
+        }
+    }
+}
+
+static void test_central_init(void)
+{
+    bst_ticker_set_next_tick_absolute(TEST_TIMEOUT_US);
+    bst_result = In_progress;
+}
+
+static void test_central_tick(bs_time_t hw_device_time)
+{
+    if (bst_result != Passed)
+    {
+        FAIL("Central: no complete run within the timeout\n");
+    }
+}
+
+static void test_central_main(void)
+{
+    uint dev_nbrs[] = { NOTIFY_TEST_DEV_PERIPHERAL };
+    uint channels[] = { NOTIFY_TEST_BACKCHANNEL };
+    uint32_t start_us;
+    int err;
+
+    if (!bs_open_back_channel(NOTIFY_TEST_DEV_CENTRAL, dev_nbrs, channels,
+                              ARRAY_SIZE(channels)))
+    {
+        FAIL("Central: could not open the backchannel\n");
+        return;
+    }
+
+    err = bt_enable(NULL);
+    if (err < 0)
+    {
+        FAIL("Bluetooth init failed (%d)\n", err);
+        return;
+    }
+
+    err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+    if (err < 0)
+    {
+        FAIL("Scanning failed to start (%d)\n", err);
+        return;
+    }
+
+    if (k_sem_take(&connected_sem, SETUP_TIMEOUT) < 0)
+    {
+        FAIL("Peripheral not found\n");
+        return;
+    }
+
+    if ((link_setup() < 0) || (subscribe() < 0))
+    {
+        return;
+    }
+
+    start_us = now_us();
+    k_sleep(K_SECONDS(arg_duration_s));
+
+    report(now_us() - start_us);
+
+    // Ends the test on the peripheral side too
+    bt_conn_disconnect(p_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    k_sem_take(&disconnected_sem, SETUP_TIMEOUT);
+}
+
+static const struct bst_test_instance test_central[] = {
+    {
+        .test_id = "central",
+        .test_descr = "Subscribes to the metrics characteristic and measures "
+                      "notification throughput, latency and drops",
+        .test_args_f = test_central_args,
+        .test_post_init_f = test_central_init,
+        .test_tick_f = test_central_tick,
+        .test_main_f = test_central_main,
+    },
+    BSTEST_END_MARKER
+};
+
+static struct bst_test_list *test_central_install(struct bst_test_list *p_tests)
+{
+    return bst_add_tests(p_tests, test_central);
+}
+
+bst_test_install_t test_installers[] = {
+    test_central_install,
+    NULL
+};
+
+int main(void)
+{
+    bst_main();
+
+    return 0;
+}
\ No newline at end of file
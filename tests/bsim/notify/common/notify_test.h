@@ -0,0 +1,24 @@
+#ifndef _NOTIFY_TEST_H_
+#define _NOTIFY_TEST_H_
+
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+// Peripheral and central, as given with -d= to the simulated devices
+#define NOTIFY_TEST_DEV_PERIPHERAL 0
+#define NOTIFY_TEST_DEV_CENTRAL 1
+
+#define NOTIFY_TEST_BACKCHANNEL 0
+
+// Sent over the backchannel by the peripheral for every notification it
+// queued, so the central can match it with the notification when it arrives.
+// Times are simulated microseconds, the same on both devices.
+typedef struct __packed notify_test_rec
+{
+    uint32_t seq;           // Queued notifications so far, this one included
+    uint32_t num_failed;    // Notifications the stack refused so far
+    uint32_t publish_us;    // Newest metrics snapshot in the message
+    uint32_t queue_us;      // Handed to the stack
+} notify_test_rec_t;
+
+#endif /* _NOTIFY_TEST_H_ */
\ No newline at end of file
@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+# Builds the peripheral and central images of the notification test for
+# nrf52_bsim and installs them in ${BSIM_OUT_PATH}/bin
+#
+#   BSIM_OUT_PATH=... BSIM_COMPONENTS_PATH=... ./compile.sh
+#
+# BabbleSim is opt-in, enable its group once in the workspace and update:
+#
+#   west config manifest.group-filter -- +babblesim
+#   west update
+#
+# west then fetches it into tools/bsim next to zephyr. Build it there once
+# with "make everything", then point BSIM_OUT_PATH at tools/bsim and
+# BSIM_COMPONENTS_PATH at tools/bsim/components.
+
+set -ue
+
+: "${BSIM_OUT_PATH:?BSIM_OUT_PATH must be set}"
+: "${BSIM_COMPONENTS_PATH:?BSIM_COMPONENTS_PATH must be set}"
+
+TEST_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
+BUILD_DIR=${BUILD_DIR:-${TEST_DIR}/build}
+
+for image in peripheral central; do
+    west build -p auto -b nrf52_bsim -d "${BUILD_DIR}/${image}" "${TEST_DIR}/${image}"
+    cp "${BUILD_DIR}/${image}/zephyr/zephyr.exe" \
+       "${BSIM_OUT_PATH}/bin/bs_nrf52_bsim_ble_periph_notify_${image}"
+done
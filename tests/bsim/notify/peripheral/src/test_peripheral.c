@@ -0,0 +1,270 @@
+/**
+ * Peripheral side of the notification throughput and latency test.
+ *
+ * Runs the application unchanged on emulated sensors: a MAX30100 sampling a
+ * 71 bpm pulse wave and an ADC reading a skin conductance level with a
+ * response every 20 s. The application's calls to send a notification and
+ * to publish metrics are renamed at build time to the wrappers below, which
+ * time them and tell the central about every queued notification over the
+ * backchannel.
+ *
+ * Test arguments (-argstest):
+ *   send=all     send every message, the default, to load the radio path
+ *   send=policy  leave the decision to the reporting policy
+*/
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/bluetooth/conn.h>
+#include <drivers/sensor/max30100_emul.h>
+
+#include "bs_types.h"
+#include "bs_tracing.h"
+#include "bstests.h"
+#include "bs_pc_backchannel.h"
+
+#include "notify_test.h"
+#include "bt.h"
+#include "metrics.h"
+#include "report.h"
+
+#define FAIL(...)                                   \
+    do                                              \
+    {                                               \
+        bst_result = Failed;                        \
+        bs_trace_error_time_line(__VA_ARGS__);      \
+    } while (0)
+
+#define PASS(...)                                   \
+    do                                              \
+    {                                               \
+        bst_result = Passed;                        \
+        bs_trace_info_time(1, __VA_ARGS__);         \
+    } while (0)
+
+// Upper bound of any run, the central ends the test well before
+#define TEST_TIMEOUT_US (30 * 60 * 1000000ULL)
+
+#define EDA_ADC_CHANNEL 4
+
+// Divider output with open electrodes, then the skin conductance level on
+// top of it, as seen by the calibration and the EDA pipeline
+#define EDA_OFFSET_MV 275
+#define EDA_TONIC_MV 250
+#define EDA_SCR_MV 20
+#define EDA_SCR_PERIOD_MS 20000
+#define EDA_SCR_RISE_MS 1000
+#define EDA_SCR_FALL_MS 4000
+
+// Raw reads the offset calibration averages on the first connection
+#define EDA_CAL_NUM_SAMPLES 64
+
+#define PPG_DC_IR 50000
+#define PPG_DC_RED 40000
+
+extern enum bst_result_t bst_result;
+
+int app_main(void);
+
+// One beat sampled at 50 Hz, 71 bpm, a systolic peak and a dicrotic wave
+static const uint16_t pulse[] = {
+    0, 0, 2, 15, 71, 243, 606, 1102, 1463, 1417, 1003, 520, 204, 81,
+    82, 158, 285, 436, 558, 599, 539, 406, 256, 135, 60, 22, 7, 2,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const struct device *const p_adc_dev = DEVICE_DT_GET(DT_NODELABEL(adc0));
+static const struct emul *const p_ppg_emul = EMUL_DT_GET(DT_NODELABEL(max30100));
+
+static bool send_all = true;
+static uint32_t num_queued;
+static uint32_t num_failed;
+static atomic_t publish_us;
+static uint32_t num_adc_reads;
+
+static inline uint32_t now_us(void)
+{
+    return (uint32_t) k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void ppg_signal(const struct emul *p_target, uint32_t num,
+                       uint16_t *p_ir, uint16_t *p_red, void *p_user_data)
+{
+    uint16_t pulse_val = pulse[num % ARRAY_SIZE(pulse)];
+
+    *p_ir = PPG_DC_IR + pulse_val;
+    *p_red = PPG_DC_RED + (2 * pulse_val) / 3;
+}
+
+static int eda_signal(const struct device *p_dev, unsigned int chan,
+                      void *p_data, uint32_t *p_result_mv)
+{
+    uint32_t t_ms = k_uptime_get_32() % EDA_SCR_PERIOD_MS;
+    uint32_t scr_mv = 0;
+
+    // The first connection starts with an offset calibration, which expects
+    // open electrodes
+    if (num_adc_reads++ < EDA_CAL_NUM_SAMPLES)
+    {
+        *p_result_mv = EDA_OFFSET_MV;
+        return 0;
+    }
+
+    if (t_ms < EDA_SCR_RISE_MS)
+    {
+        scr_mv = (EDA_SCR_MV * t_ms) / EDA_SCR_RISE_MS;
+    }
+    else if (t_ms < EDA_SCR_RISE_MS + EDA_SCR_FALL_MS)
+    {
+        scr_mv = (EDA_SCR_MV * (EDA_SCR_RISE_MS + EDA_SCR_FALL_MS - t_ms)) / EDA_SCR_FALL_MS;
+    }
+
+    *p_result_mv = EDA_OFFSET_MV + EDA_TONIC_MV + scr_mv;
+
+    return 0;
+}
+
+bool test_metrics_publish(metrics_topic_t topic, const void *p_data, size_t size)
+{
+    atomic_set(&publish_us, (atomic_val_t) now_us());
+
+    return metrics_publish(topic, p_data, size);
+}
+
+bool test_report_should_send(const uint8_t *p_msg)
+{
+    bool send = report_should_send(p_msg);
+
+    return send_all || send;
+}
+
+int test_bt_send_notification(uint8_t *data, size_t len)
+{
+    notify_test_rec_t rec;
+    uint32_t queue_us = now_us();
+    int err;
+
+    err = bt_send_notification(data, len);
+    if (err < 0)
+    {
+        num_failed++;
+        return err;
+    }
+
+    rec.seq = ++num_queued;
+    rec.num_failed = num_failed;
+    rec.publish_us = (uint32_t) atomic_get(&publish_us);
+    rec.queue_us = queue_us;
+
+    bs_bc_send_msg(NOTIFY_TEST_BACKCHANNEL, (uint8_t *) &rec, sizeof(rec));
+
+    return err;
+}
+
+static void disconnected(struct bt_conn *p_conn, uint8_t reason)
+{
+    if (num_queued > 0)
+    {
+        PASS("Peripheral: %u notifications queued, %u refused by the stack\n",
+             num_queued, num_failed);
+    }
+    else
+    {
+        FAIL("Peripheral: disconnected (0x%02x) without sending anything\n", reason);
+    }
+}
+
+BT_CONN_CB_DEFINE(test_conn_callbacks) = {
+    .disconnected = disconnected,
+};
+
+static void test_peripheral_args(int argc, char *argv[])
+{
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "send=policy"))
+        {
+            send_all = false;
+        }
+        else if (0 == strcmp(argv[i], "send=all"))
+        {
+            send_all = true;
+        }
+        else
+        {
+            bs_trace_error_line("Unknown argument %s\n", argv[i]);
+        }
+    }
+}
+
+static void test_peripheral_init(void)
+{
+    bst_ticker_set_next_tick_absolute(TEST_TIMEOUT_US);
+    bst_result = In_progress;
+}
+
+static void test_peripheral_tick(bs_time_t hw_device_time)
+{
+    if (bst_result != Passed)
+    {
+        FAIL("Peripheral: no complete run within the timeout\n");
+    }
+}
+
+static void test_peripheral_main(void)
+{
+    uint dev_nbrs[] = { NOTIFY_TEST_DEV_CENTRAL };
+    uint channels[] = { NOTIFY_TEST_BACKCHANNEL };
+    int err;
+
+    if (!bs_open_back_channel(NOTIFY_TEST_DEV_PERIPHERAL, dev_nbrs, channels,
+                              ARRAY_SIZE(channels)))
+    {
+        FAIL("Peripheral: could not open the backchannel\n");
+        return;
+    }
+
+    max30100_emul_set_signal(p_ppg_emul, ppg_signal, NULL);
+
+    err = adc_emul_value_func_set(p_adc_dev, EDA_ADC_CHANNEL, eda_signal, NULL);
+    if (err < 0)
+    {
+        FAIL("Peripheral: could not emulate the EDA input (%d)\n", err);
+        return;
+    }
+
+    app_main();
+}
+
+static const struct bst_test_instance test_peripheral[] = {
+    {
+        .test_id = "peripheral",
+        .test_descr = "The application on emulated sensors, reporting every "
+                      "queued notification over the backchannel",
+        .test_args_f = test_peripheral_args,
+        .test_post_init_f = test_peripheral_init,
+        .test_tick_f = test_peripheral_tick,
+        .test_main_f = test_peripheral_main,
+    },
+    BSTEST_END_MARKER
+};
+
+static struct bst_test_list *test_peripheral_install(struct bst_test_list *p_tests)
+{
+    return bst_add_tests(p_tests, test_peripheral);
+}
+
+bst_test_install_t test_installers[] = {
+    test_peripheral_install,
+    NULL
+};
+
+int main(void)
+{
+    bst_main();
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#!/usr/bin/env bash
+# Runs the notification test over connection intervals, ATT MTUs and PHYs
+# and collects one RESULT line per combination in ${RESULTS}
+#
+# The peripheral sends every message (send=all) so the radio path is loaded
+# at APP_REPORT_PERIOD_MS regardless of the reporting policy. Pass
+# send=policy in PERIPHERAL_ARGS to measure the policy instead.
+
+source ${ZEPHYR_BASE}/tests/bsim/sh_common.source
+
+verbosity_level=2
+EXECUTE_TIMEOUT=600
+
+DURATION_S=${DURATION_S:-60}
+PERIPHERAL_ARGS=${PERIPHERAL_ARGS:-send=all}
+CENTRAL_ARGS=${CENTRAL_ARGS:-}
+RESULTS=${RESULTS:-${BSIM_OUT_PATH}/results/ble_periph_notify/sweep.txt}
+
+# Connection intervals in 1.25 ms units: 7.5 ms, 30 ms, 100 ms, 500 ms
+INTERVALS="6 24 80 400"
+MTUS="23 247"
+PHYS="1m 2m coded"
+
+# The central needs time to find the peripheral and set the link up
+SIM_LENGTH_US=$(( (DURATION_S + 20) * 1000000 ))
+
+cd ${BSIM_OUT_PATH}/bin
+
+LOG_DIR=$(dirname ${RESULTS})
+mkdir -p ${LOG_DIR}
+: > ${RESULTS}
+
+for interval in ${INTERVALS}; do
+  for mtu in ${MTUS}; do
+    for phy in ${PHYS}; do
+      simulation_id="ble_periph_notify_${interval}_${mtu}_${phy}"
+
+      Execute ./bs_nrf52_bsim_ble_periph_notify_peripheral \
+        -v=${verbosity_level} -s=${simulation_id} -d=0 -RealEncryption=0 \
+        -testid=peripheral -argstest ${PERIPHERAL_ARGS}
+
+      Execute ./bs_nrf52_bsim_ble_periph_notify_central \
+        -v=${verbosity_level} -s=${simulation_id} -d=1 -RealEncryption=0 \
+        -testid=central -argstest interval=${interval} mtu=${mtu} phy=${phy} \
+        duration_s=${DURATION_S} ${CENTRAL_ARGS} > ${LOG_DIR}/${simulation_id}.log
+
+      Execute ./bs_2G4_phy_v1 -v=${verbosity_level} -s=${simulation_id} \
+        -D=2 -sim_length=${SIM_LENGTH_US}
+
+      wait_for_background_jobs
+
+      grep -h "RESULT" ${LOG_DIR}/${simulation_id}.log >> ${RESULTS} || true
+    done
+  done
+done
+
+cat ${RESULTS}
@@ -0,0 +1,47 @@
+#-------------------------------------------------------------------------------
+# Build-time FIR design, see fir_design.py
+#
+#   fir_design(<header> NAME <prefix> RATE_MHZ <n> CUTOFF_MHZ <n> TAPS <n>
+#              [FRAC_BITS <n>] [GAIN_PCT <n>])
+#
+# Runs when configuring, Kconfig changes reconfigure the build anyway
+
+set(FIR_DESIGN_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/fir_design.py)
+
+# Zephyr builds have found Python already, the host tools have not
+if(NOT PYTHON_EXECUTABLE)
+    find_package(Python3 REQUIRED COMPONENTS Interpreter)
+    set(PYTHON_EXECUTABLE ${Python3_EXECUTABLE})
+endif()
+
+function(fir_design header)
+    cmake_parse_arguments(FIR "" "NAME;RATE_MHZ;CUTOFF_MHZ;TAPS;FRAC_BITS;GAIN_PCT" "" ${ARGN})
+
+    if(NOT FIR_FRAC_BITS)
+        set(FIR_FRAC_BITS 15)
+    endif()
+    if(NOT FIR_GAIN_PCT)
+        set(FIR_GAIN_PCT 100)
+    endif()
+
+    get_filename_component(header_dir ${header} DIRECTORY)
+    file(MAKE_DIRECTORY ${header_dir})
+
+    execute_process(
+        COMMAND ${PYTHON_EXECUTABLE} ${FIR_DESIGN_SCRIPT}
+            --name ${FIR_NAME}
+            --rate-mhz ${FIR_RATE_MHZ}
+            --cutoff-mhz ${FIR_CUTOFF_MHZ}
+            --taps ${FIR_TAPS}
+            --frac-bits ${FIR_FRAC_BITS}
+            --gain-pct ${FIR_GAIN_PCT}
+            -o ${header}
+        RESULT_VARIABLE ret
+        ERROR_VARIABLE err
+    )
+    if(NOT ret EQUAL 0)
+        message(FATAL_ERROR "FIR design failed: ${err}")
+    endif()
+
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${FIR_DESIGN_SCRIPT})
+endfunction()
\ No newline at end of file
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""
+Designs a linear phase low-pass FIR filter and writes its coefficients to a C
+header, for the filters of the signal processing core.
+
+The design is a Hamming windowed sinc, the same as scipy.signal.firwin(), so
+the coefficients can be checked against it. Only odd tap counts are allowed,
+which makes the filter symmetric around a centre tap with a delay of a whole
+number of samples.
+
+The header defines initialisers for four variants of the same filter:
+  <NAME>_COEFS            all taps, float
+  <NAME>_COEFS_FOLDED     first half of the taps and the centre tap, float
+  <NAME>_COEFS_Q          all taps, fixed point with <NAME>_FRAC_BITS
+  <NAME>_COEFS_FOLDED_Q   folded, fixed point
+
+A folded filter adds the two samples that share a coefficient before the
+multiply, which halves the multiplies. The fixed point taps are rounded and
+the centre tap absorbs the rounding error, so the DC gain is exact.
+
+Plain Python without third party packages, it runs as part of the CMake
+configure step.
+"""
+
+import argparse
+import io
+import math
+import sys
+
+# Frequencies are passed in mHz, as Kconfig has no floating point options
+MHZ_PER_HZ = 1000
+
+
+def sinc(x):
+    if x == 0:
+        return 1.0
+    return math.sin(math.pi * x) / (math.pi * x)
+
+
+def hamming(n, num_taps):
+    return 0.54 - 0.46 * math.cos(2 * math.pi * n / (num_taps - 1))
+
+
+def design(num_taps, cutoff, gain):
+    """Taps of a low-pass filter with the cutoff relative to the sample rate"""
+    centre = (num_taps - 1) // 2
+    taps = [2 * cutoff * sinc(2 * cutoff * (n - centre)) * hamming(n, num_taps)
+            for n in range(num_taps)]
+    scale = gain / sum(taps)
+
+    return [t * scale for t in taps]
+
+
+def quantise(taps, frac_bits, gain):
+    taps_q = [int(round(t * (1 << frac_bits))) for t in taps]
+    centre = len(taps) // 2
+
+    taps_q[centre] += int(round(gain * (1 << frac_bits))) - sum(taps_q)
+
+    return taps_q
+
+
+def response_db(taps, freq):
+    """Magnitude response at a frequency relative to the sample rate"""
+    re = sum(t * math.cos(2 * math.pi * freq * n) for n, t in enumerate(taps))
+    im = sum(t * math.sin(2 * math.pi * freq * n) for n, t in enumerate(taps))
+    dc = sum(taps)
+
+    return 20 * math.log10(max(math.hypot(re, im) / dc, 1e-12))
+
+
+def corner(taps, level_db):
+    """Lowest frequency where the response drops below level_db"""
+    steps = 10000
+    for i in range(steps // 2 + 1):
+        if response_db(taps, i / steps) < level_db:
+            return i / steps
+    return 0.5
+
+
+def initialiser(values, fmt):
+    lines = []
+    for i in range(0, len(values), 4):
+        lines.append('    ' + ', '.join(fmt(v) for v in values[i:i + 4]))
+
+    return ' \\\n{ \\\n' + ', \\\n'.join(lines) + ' \\\n}'
+
+
+def float_str(value):
+    return '{:.9e}f'.format(value)
+
+
+def write_header(f, args, taps, taps_q):
+    name = args.name.upper()
+    guard = '_{}_H_'.format(name)
+    folded = (len(taps) + 1) // 2
+    rate_hz = args.rate_mhz / MHZ_PER_HZ
+
+    f.write('/*\n')
+    f.write(' * Generated by tools/fir_design/fir_design.py, do not edit.\n')
+    f.write(' *\n')
+    f.write(' * Low-pass FIR, Hamming windowed sinc\n')
+    f.write(' * Sample rate {:.3f} Hz, cutoff {:.3f} Hz, {} taps, DC gain {:.3f}\n'
+            .format(rate_hz, args.cutoff_mhz / MHZ_PER_HZ, len(taps), args.gain_pct / 100))
+    f.write(' * -3 dB at {:.3f} Hz, -40 dB at {:.3f} Hz, delay {} samples\n'
+            .format(corner(taps, -3) * rate_hz, corner(taps, -40) * rate_hz,
+                    (len(taps) - 1) // 2))
+    f.write('*/\n\n')
+    f.write('#ifndef {}\n#define {}\n\n'.format(guard, guard))
+    f.write('#define {}_NUM_TAPS {}\n'.format(name, len(taps)))
+    f.write('#define {}_NUM_FOLDED {}\n'.format(name, folded))
+    f.write('#define {}_FRAC_BITS {}\n'.format(name, args.frac_bits))
+    f.write('#define {}_GROUP_DELAY {}\n'.format(name, (len(taps) - 1) // 2))
+    f.write('#define {}_DC_GAIN_Q {}\n\n'.format(name, sum(taps_q)))
+    f.write('#define {}_COEFS{}\n\n'.format(name, initialiser(taps, float_str)))
+    f.write('#define {}_COEFS_FOLDED{}\n\n'.format(name, initialiser(taps[:folded], float_str)))
+    f.write('#define {}_COEFS_Q{}\n\n'.format(name, initialiser(taps_q, str)))
+    f.write('#define {}_COEFS_FOLDED_Q{}\n\n'.format(name, initialiser(taps_q[:folded], str)))
+    f.write('#endif /* {} */\n'.format(guard))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--name', required=True,
+                        help='prefix of the generated macros, e.g. EDA_FIR')
+    parser.add_argument('--rate-mhz', type=int, required=True,
+                        help='sample rate in mHz')
+    parser.add_argument('--cutoff-mhz', type=int, required=True,
+                        help='-6 dB frequency in mHz')
+    parser.add_argument('--taps', type=int, required=True,
+                        help='number of taps, odd')
+    parser.add_argument('--frac-bits', type=int, default=15,
+                        help='fractional bits of the fixed point taps')
+    parser.add_argument('--gain-pct', type=int, default=100,
+                        help='DC gain in percent')
+    parser.add_argument('-o', '--output', required=True,
+                        help='header to write')
+    args = parser.parse_args()
+
+    if (args.taps < 3) or (args.taps % 2 == 0):
+        sys.exit('{}: number of taps has to be odd and at least 3, got {}'
+                 .format(args.name, args.taps))
+
+    if not 0 < args.cutoff_mhz < args.rate_mhz / 2:
+        sys.exit('{}: cutoff {} mHz is not below the Nyquist frequency of a '
+                 '{} mHz sample rate'.format(args.name, args.cutoff_mhz, args.rate_mhz))
+
+    if not 1 <= args.frac_bits <= 30:
+        sys.exit('{}: {} fractional bits out of range'.format(args.name, args.frac_bits))
+
+    taps = design(args.taps, args.cutoff_mhz / args.rate_mhz, args.gain_pct / 100)
+    taps_q = quantise(taps, args.frac_bits, args.gain_pct / 100)
+
+    header = io.StringIO()
+    write_header(header, args, taps, taps_q)
+
+    # Leaves an unchanged header alone, so a reconfigure does not rebuild
+    try:
+        with open(args.output) as f:
+            if f.read() == header.getvalue():
+                return
+    except OSError:
+        pass
+
+    with open(args.output, 'w') as f:
+        f.write(header.getvalue())
+
+
+if __name__ == '__main__':
+    main()
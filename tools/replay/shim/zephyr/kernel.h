@@ -0,0 +1,115 @@
+/**
+ * Host shim of the few kernel services the processing core uses. The replay
+ * tool is single threaded, so locks compile to nothing, and the cycle
+ * counter counts nanoseconds.
+*/
+
+#ifndef _SHIM_KERNEL_H_
+#define _SHIM_KERNEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define CLAMP(val, low, high) (((val) <= (low)) ? (low) : MIN(val, high))
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define BIT(n) (1UL << (n))
+
+#define BUILD_ASSERT(cond, ...) _Static_assert(cond, "" __VA_ARGS__)
+
+#define K_FOREVER 0
+
+struct k_mutex
+{
+    int unused;
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name
+
+static inline int k_mutex_init(struct k_mutex *p_mutex)
+{
+    (void) p_mutex;
+    return 0;
+}
+
+static inline int k_mutex_lock(struct k_mutex *p_mutex, int timeout)
+{
+    (void) p_mutex;
+    (void) timeout;
+    return 0;
+}
+
+static inline int k_mutex_unlock(struct k_mutex *p_mutex)
+{
+    (void) p_mutex;
+    return 0;
+}
+
+struct k_spinlock
+{
+    int unused;
+};
+
+typedef int k_spinlock_key_t;
+
+static inline k_spinlock_key_t k_spin_lock(struct k_spinlock *p_lock)
+{
+    (void) p_lock;
+    return 0;
+}
+
+static inline void k_spin_unlock(struct k_spinlock *p_lock, k_spinlock_key_t key)
+{
+    (void) p_lock;
+    (void) key;
+}
+
+static inline void k_sched_lock(void)
+{
+}
+
+static inline void k_sched_unlock(void)
+{
+}
+
+static inline uint64_t shim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint32_t k_cycle_get_32(void)
+{
+    return (uint32_t) shim_now_ns();
+}
+
+static inline uint32_t k_cyc_to_us_floor32(uint32_t cycles)
+{
+    return cycles / 1000U;
+}
+
+// Ticks are microseconds on the host
+static inline int64_t k_uptime_ticks(void)
+{
+    return (int64_t) (shim_now_ns() / 1000ULL);
+}
+
+static inline uint64_t k_ticks_to_us_floor64(uint64_t ticks)
+{
+    return ticks;
+}
+
+static inline int64_t k_uptime_get(void)
+{
+    return (int64_t) (shim_now_ns() / 1000000ULL);
+}
+
+#endif /* _SHIM_KERNEL_H_ */
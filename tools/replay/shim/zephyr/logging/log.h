@@ -0,0 +1,15 @@
+#ifndef _SHIM_LOG_H_
+#define _SHIM_LOG_H_
+
+#include <stdio.h>
+
+// Errors and warnings go to stderr, the rest is compiled out but still
+// type checked
+#define LOG_MODULE_REGISTER(name, level)
+
+#define LOG_ERR(...) do { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOG_WRN(...) do { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOG_INF(...) do { if (0) { fprintf(stderr, __VA_ARGS__); } } while (0)
+#define LOG_DBG(...) do { if (0) { fprintf(stderr, __VA_ARGS__); } } while (0)
+
+#endif /* _SHIM_LOG_H_ */
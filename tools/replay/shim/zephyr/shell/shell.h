@@ -0,0 +1,6 @@
+#ifndef _SHIM_SHELL_H_
+#define _SHIM_SHELL_H_
+
+// No shell on the host, CONFIG_SHELL is never set
+
+#endif /* _SHIM_SHELL_H_ */
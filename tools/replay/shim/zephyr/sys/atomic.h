@@ -0,0 +1,38 @@
+#ifndef _SHIM_ATOMIC_H_
+#define _SHIM_ATOMIC_H_
+
+#include <stdbool.h>
+
+typedef long atomic_t;
+typedef long atomic_val_t;
+
+#define ATOMIC_INIT(i) (i)
+
+static inline atomic_val_t atomic_get(const atomic_t *p_target)
+{
+    return __atomic_load_n(p_target, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_set(atomic_t *p_target, atomic_val_t value)
+{
+    return __atomic_exchange_n(p_target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_inc(atomic_t *p_target)
+{
+    return __atomic_fetch_add(p_target, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_clear(atomic_t *p_target)
+{
+    return atomic_set(p_target, 0);
+}
+
+static inline bool atomic_cas(atomic_t *p_target, atomic_val_t old_value,
+                              atomic_val_t new_value)
+{
+    return __atomic_compare_exchange_n(p_target, &old_value, new_value, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#endif /* _SHIM_ATOMIC_H_ */
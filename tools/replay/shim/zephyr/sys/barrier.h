@@ -0,0 +1,9 @@
+#ifndef _SHIM_BARRIER_H_
+#define _SHIM_BARRIER_H_
+
+static inline void barrier_dmem_fence_full(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif /* _SHIM_BARRIER_H_ */
@@ -0,0 +1,477 @@
+/**
+ * Replays a recording of raw sensor samples through the PPG and EDA
+ * processing cores of the application and reports what they detect, along
+ * with the processing throughput and per-stage timing.
+ *
+ * CSV recordings have one sample per line, in the order they were taken:
+ *   p,<red>,<ir>   PPG sample, 50 Hz
+ *   e,<raw>        EDA raw ADC code, 100 Hz
+ * Empty lines and lines starting with '#' are skipped. Binary recordings are
+ * a sequence of 12-byte little endian records: the stream ('p' or 'e') in
+ * the first byte, 3 reserved bytes, then two int32 values (red and IR, or
+ * the raw EDA code and 0).
+ *
+ * Results go to stdout as CSV, one event per line. Times are on the shared
+ * timebase, with both streams starting at 0 and the filter delays removed,
+ * so beats and SCRs line up with the samples that caused them:
+ *   beat,<t_s>,<ibi_ms>,<sqi>,<valid>
+ *   scr,<onset_t_s>,<amplitude_ns>,<rise_time_ms>
+ *   ppg,<t_s>,<hr_bpm>,<rmssd_ms>,<amplitude>,<spo2_pct>,<sqi>,<resp_bpm>,<resp_quality>
+ *   eda,<t_s>,<epc>,<tonic_ns>,<range_ns>,<scr_per_min>
+ *   minute,<minute>,<hr_min>,<hr_mean>,<hr_max>,<beats>,<tonic_ns>,<scrs>,<zone_s>...
+ *   zones,<zone_s>...
+ * The metrics lines are printed whenever the published snapshot changes.
+ * The per-minute summaries and the HR zone totals follow at the end, fetched
+ * page by page from the same serialization the GATT characteristic reads.
+ * The throughput summary goes to stderr.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "ppg_proc.h"
+#include "eda_proc.h"
+#include "metrics.h"
+#include "summary.h"
+#include "prof.h"
+
+#define RECORD_LEN 12
+
+// Full scale of the ESP32-C3 ADC with the internal reference and no
+// attenuation, as reported by adc_raw_to_millivolts()
+#define DEFAULT_FULL_SCALE_MV 1100
+
+#define DEFAULT_RESOLUTION_BITS 16
+
+// Same as the page of the summary characteristic
+#define SUMMARY_PAGE_LEN 512
+
+typedef enum stream
+{
+    STREAM_PPG = 'p',
+    STREAM_EDA = 'e',
+} stream_t;
+
+typedef struct record
+{
+    stream_t stream;
+    int32_t a;
+    int32_t b;
+} record_t;
+
+typedef struct recording
+{
+    record_t *p_records;
+    size_t num_records;
+    size_t capacity;
+} recording_t;
+
+typedef struct replay_stats
+{
+    uint64_t num_ppg;
+    uint64_t num_eda;
+    uint64_t num_beats;
+    uint64_t num_scr;
+} replay_stats_t;
+
+static int recording_add(recording_t *p_rec, stream_t stream, int32_t a, int32_t b);
+static int load_csv(FILE *p_file, recording_t *p_rec);
+static int load_bin(FILE *p_file, recording_t *p_rec);
+static int replay(const recording_t *p_rec, bool quiet, replay_stats_t *p_stats);
+static void print_minutes(int64_t end_us);
+static void print_summary(const replay_stats_t *p_stats, uint64_t elapsed_ns);
+static void usage(const char *p_prog);
+
+int main(int argc, char **argv)
+{
+    recording_t rec = {0};
+    replay_stats_t stats = {0};
+    eda_cal_t cal = {
+        .gain = 1 << EDA_CAL_GAIN_FRAC_BITS,
+        .offset = EDA_CAL_DEFAULT_OFFSET,
+    };
+    int32_t full_scale_mv = DEFAULT_FULL_SCALE_MV;
+    uint8_t resolution_bits = DEFAULT_RESOLUTION_BITS;
+    unsigned long repeat = 1;
+    bool binary = false;
+    bool quiet = false;
+    const char *p_path;
+    const char *p_ext;
+    FILE *p_file;
+    uint64_t start_ns;
+    int err;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "bqn:r:o:g:m:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                binary = true;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 'n':
+                repeat = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                resolution_bits = (uint8_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                cal.offset = (uint16_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'g':
+                cal.gain = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'm':
+                full_scale_mv = (int32_t) strtol(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if ((optind != argc - 1) || (0 == repeat))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    p_path = argv[optind];
+    p_ext = strrchr(p_path, '.');
+    if (p_ext && (0 == strcmp(p_ext, ".bin")))
+    {
+        binary = true;
+    }
+
+    p_file = fopen(p_path, binary ? "rb" : "r");
+    if (!p_file)
+    {
+        perror(p_path);
+        return 1;
+    }
+
+    // Parsing is kept out of the timed part
+    err = binary ? load_bin(p_file, &rec) : load_csv(p_file, &rec);
+    fclose(p_file);
+    if (err != 0)
+    {
+        free(rec.p_records);
+        return 1;
+    }
+
+    ppg_proc_set_resolution(resolution_bits);
+    eda_proc_set_cal(&cal, full_scale_mv);
+
+    start_ns = shim_now_ns();
+
+    for (unsigned long i = 0; (i < repeat) && (0 == err); i++)
+    {
+        // Only the first pass prints, the others are for timing
+        err = replay(&rec, quiet || (i > 0), &stats);
+    }
+
+    if (0 == err)
+    {
+        print_summary(&stats, shim_now_ns() - start_ns);
+    }
+
+    free(rec.p_records);
+
+    return (0 == err) ? 0 : 1;
+}
+
+static int recording_add(recording_t *p_rec, stream_t stream, int32_t a, int32_t b)
+{
+    record_t *p_records;
+    size_t capacity;
+
+    if (p_rec->num_records == p_rec->capacity)
+    {
+        capacity = p_rec->capacity ? (2 * p_rec->capacity) : 4096;
+        p_records = realloc(p_rec->p_records, capacity * sizeof(record_t));
+        if (!p_records)
+        {
+            fprintf(stderr, "Out of memory\n");
+            return -ENOMEM;
+        }
+
+        p_rec->p_records = p_records;
+        p_rec->capacity = capacity;
+    }
+
+    p_rec->p_records[p_rec->num_records++] = (record_t) {
+        .stream = stream,
+        .a = a,
+        .b = b,
+    };
+
+    return 0;
+}
+
+static int load_csv(FILE *p_file, recording_t *p_rec)
+{
+    char line[128];
+    size_t line_num = 0;
+    char stream;
+    long a;
+    long b;
+    int num_fields;
+    int err = 0;
+
+    while ((0 == err) && fgets(line, sizeof(line), p_file))
+    {
+        line_num++;
+
+        if (('#' == line[0]) || ('\n' == line[0]) || ('\r' == line[0]))
+        {
+            continue;
+        }
+
+        b = 0;
+        num_fields = sscanf(line, " %c,%ld,%ld", &stream, &a, &b);
+
+        if ((STREAM_PPG == stream) && (3 == num_fields))
+        {
+            err = recording_add(p_rec, STREAM_PPG, (int32_t) a, (int32_t) b);
+        }
+        else if ((STREAM_EDA == stream) && (num_fields >= 2))
+        {
+            err = recording_add(p_rec, STREAM_EDA, (int32_t) a, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Line %zu: expected p,<red>,<ir> or e,<raw>\n", line_num);
+            err = -EINVAL;
+        }
+    }
+
+    return err;
+}
+
+static int load_bin(FILE *p_file, recording_t *p_rec)
+{
+    uint8_t buf[RECORD_LEN];
+    size_t record_num = 0;
+    int32_t a;
+    int32_t b;
+    int err = 0;
+
+    while ((0 == err) && (fread(buf, 1, sizeof(buf), p_file) == sizeof(buf)))
+    {
+        a = (int32_t) sys_get_le32(&buf[4]);
+        b = (int32_t) sys_get_le32(&buf[8]);
+
+        if ((STREAM_PPG == buf[0]) || (STREAM_EDA == buf[0]))
+        {
+            err = recording_add(p_rec, (stream_t) buf[0], a, b);
+        }
+        else
+        {
+            fprintf(stderr, "Record %zu: unknown stream 0x%02x\n", record_num, buf[0]);
+            err = -EINVAL;
+        }
+
+        record_num++;
+    }
+
+    return err;
+}
+
+static int replay(const recording_t *p_rec, bool quiet, replay_stats_t *p_stats)
+{
+    uint64_t num_ppg = 0;
+    uint64_t num_eda = 0;
+    uint32_t ppg_version = metrics_get_version(METRICS_TOPIC_PPG);
+    uint32_t eda_version = metrics_get_version(METRICS_TOPIC_EDA);
+    uint32_t version;
+    metrics_ppg_t ppg;
+    metrics_eda_t eda;
+    ppg_beat_t beat;
+    scr_event_t scr;
+    int64_t end_us;
+
+    if ((ppg_proc_init() != 0) || (eda_proc_init() != 0) || (summary_init() != 0))
+    {
+        fprintf(stderr, "Could not init the processing cores\n");
+        return -EIO;
+    }
+
+    for (size_t i = 0; i < p_rec->num_records; i++)
+    {
+        const record_t *p_record = &p_rec->p_records[i];
+
+        if (STREAM_PPG == p_record->stream)
+        {
+            num_ppg++;
+
+            if (ppg_proc_put_sample(p_record->a, p_record->b, &beat))
+            {
+                p_stats->num_beats++;
+
+                if (beat.valid)
+                {
+                    summary_put_beat(beat.ts_us, beat.ibi_ms);
+                }
+
+                if (!quiet)
+                {
+                    printf("beat,%.3f,%.1f,%u,%d\n", beat.ts_us / 1e6, beat.ibi_ms,
+                           beat.sqi, beat.valid);
+                }
+            }
+
+            version = metrics_get_version(METRICS_TOPIC_PPG);
+            if (!quiet && (version != ppg_version))
+            {
+                metrics_read(METRICS_TOPIC_PPG, &ppg, sizeof(ppg));
+                printf("ppg,%.2f,%u,%u,%u,%u,%u,%u,%u\n",
+                       ppg.ts_us / 1e6, ppg.hr_bpm,
+                       ppg.rmssd_ms, ppg.amplitude, ppg.spo2_pct, ppg.sqi,
+                       ppg.resp_bpm, ppg.resp_quality);
+            }
+            ppg_version = version;
+        }
+        else
+        {
+            num_eda++;
+
+            if (eda_proc_put_sample((uint16_t) p_record->a, &scr))
+            {
+                p_stats->num_scr++;
+
+                if (!quiet)
+                {
+                    printf("scr,%.2f,%.1f,%u\n", scr.ts_us / 1e6,
+                           scr.amplitude_ns, scr.rise_time_ms);
+                }
+
+                summary_put_eda((int64_t) num_eda * EDA_SAMPLE_PERIOD_MS * 1000, scr_get_tonic_ns(), 1);
+            }
+            else
+            {
+                summary_put_eda((int64_t) num_eda * EDA_SAMPLE_PERIOD_MS * 1000, scr_get_tonic_ns(), 0);
+            }
+
+            version = metrics_get_version(METRICS_TOPIC_EDA);
+            if (!quiet && (version != eda_version))
+            {
+                metrics_read(METRICS_TOPIC_EDA, &eda, sizeof(eda));
+                printf("eda,%.2f,%u,%u,%u,%u\n",
+                       eda.ts_us / 1e6, eda.epc,
+                       eda.tonic_ns, eda.range_ns, eda.scr_per_min);
+            }
+            eda_version = version;
+        }
+    }
+
+    p_stats->num_ppg += num_ppg;
+    p_stats->num_eda += num_eda;
+
+    if (!quiet)
+    {
+        // A minute later, so the last one is closed too
+        end_us = MAX((int64_t) num_ppg * PPG_SAMPLE_PERIOD_MS,
+                     (int64_t) num_eda * EDA_SAMPLE_PERIOD_MS) * 1000 + 60000000;
+        print_minutes(end_us);
+    }
+
+    return 0;
+}
+
+// Fetches the summaries the way a central does, one page at a time from the
+// minute after the last record received
+static void print_minutes(int64_t end_us)
+{
+    uint8_t page[SUMMARY_PAGE_LEN];
+    const uint8_t *p_rec = NULL;
+    uint32_t first_minute = 0;
+    size_t len;
+    uint8_t num;
+
+    do
+    {
+        len = summary_serialize(end_us, first_minute, page, sizeof(page));
+        if (len < SUMMARY_HEADER_LEN)
+        {
+            return;
+        }
+
+        num = page[SUMMARY_HEADER_LEN - 1];
+
+        for (size_t i = 0; i < num; i++)
+        {
+            p_rec = &page[SUMMARY_HEADER_LEN + i * SUMMARY_RECORD_LEN];
+
+            printf("minute,%u,%u,%u,%u,%u,%u,%u", sys_get_le32(p_rec),
+                   p_rec[4], p_rec[5], p_rec[6], p_rec[7], sys_get_le16(&p_rec[8]),
+                   p_rec[10]);
+            for (size_t j = 0; j < SUMMARY_NUM_HR_ZONES; j++)
+            {
+                printf(",%u", p_rec[11 + j]);
+            }
+            printf("\n");
+
+            first_minute = sys_get_le32(p_rec) + 1;
+        }
+    } while (num > 0);
+
+    printf("zones");
+    for (size_t j = 0; j < SUMMARY_NUM_HR_ZONES; j++)
+    {
+        printf(",%u", sys_get_le32(&page[5 + (SUMMARY_NUM_HR_ZONES - 1) + j * sizeof(uint32_t)]));
+    }
+    printf("\n");
+}
+
+static void print_summary(const replay_stats_t *p_stats, uint64_t elapsed_ns)
+{
+    double elapsed_s = elapsed_ns / 1e9;
+    double signal_s = MAX(p_stats->num_ppg * PPG_SAMPLE_PERIOD_MS,
+                          p_stats->num_eda * EDA_SAMPLE_PERIOD_MS) / 1000.0;
+    uint64_t num_samples = p_stats->num_ppg + p_stats->num_eda;
+    prof_stats_t stats;
+
+    fprintf(stderr, "%llu PPG and %llu EDA samples, %llu beats, %llu SCRs\n",
+            (unsigned long long) p_stats->num_ppg, (unsigned long long) p_stats->num_eda,
+            (unsigned long long) p_stats->num_beats, (unsigned long long) p_stats->num_scr);
+
+    if (elapsed_ns > 0)
+    {
+        fprintf(stderr, "%.1f s of signal in %.3f s: %.0f samples/s, %.0fx real time\n",
+                signal_s, elapsed_s, num_samples / elapsed_s, signal_s / elapsed_s);
+    }
+
+    fprintf(stderr, "%-24s %10s %10s %10s %10s\n", "stage (us)", "count", "min", "avg", "max");
+
+    for (size_t i = 0; i < PROF_STAGE_NUM; i++)
+    {
+        if ((0 == prof_get((prof_stage_t) i, &stats)) && (stats.count > 0))
+        {
+            fprintf(stderr, "%-24s %10u %10.2f %10.2f %10.2f\n",
+                    prof_get_name((prof_stage_t) i), stats.count,
+                    stats.min / 1000.0, stats.avg / 1000.0, stats.max / 1000.0);
+        }
+    }
+}
+
+static void usage(const char *p_prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <recording.csv|recording.bin>\n"
+            "  -b         binary recording, implied by a .bin extension\n"
+            "  -q         only print the summary\n"
+            "  -n <count> replay the recording count times, for timing\n"
+            "  -r <bits>  PPG sample resolution, 16 (MAX30100) or 18 (MAX30102)\n"
+            "  -o <code>  EDA offset calibration, default %d\n"
+            "  -g <gain>  EDA gain calibration in 1/%d, default %d\n"
+            "  -m <mV>    ADC input at full scale, default %d\n",
+            p_prog, EDA_CAL_DEFAULT_OFFSET, 1 << EDA_CAL_GAIN_FRAC_BITS,
+            1 << EDA_CAL_GAIN_FRAC_BITS, DEFAULT_FULL_SCALE_MV);
+}
\ No newline at end of file